@@ -1,10 +1,17 @@
 #!/usr/bin/env python3
-# Time-stamp: <2025-04-16 11:22:56>
+# Time-stamp: <2026-10-14 09:15:05>
 
 import re
 import os
 import argparse
+import pickle
 
+# the compiled scanning engine (see meuporg_scanner.cpp), if it was
+# built using `python3 setup.py build_ext --inplace`
+try:
+    from meuporg_engine import scan_files as engine_scan_files
+except ImportError:
+    engine_scan_files = None
 
 
 # !SECTION! Parameters
@@ -38,6 +45,9 @@ VALID_EXTENSIONS = [re.compile(r".*\.{}$".format(ext))
 # the following is used to simplify links
 HOME_DIR_LENGTH = len(os.path.realpath(os.path.expanduser("~")))
 
+# where the lines found in each file are remembered between runs
+DEFAULT_CACHE_FILE = os.path.join(os.path.expanduser("~"), ".cache", "meuporg", "scan_cache.pkl")
+
 # !SECTION! Identifying and parsing items
 # =======================================
 
@@ -197,21 +207,33 @@ class ItemScanner:
     the job of FileMap class. It returns the items as they are found,
     nothing more.
 
+    If `hits` is given, the file is not read: `hits` must instead
+    contain the pairs (line number, line) of its lines that may
+    contain an item, as returned by `scan_files`. As all the other
+    lines simply finalize the current item, the result is the same.
+
     """
-    def __init__(self, path, base_depth):
+    def __init__(self, path, base_depth, hits=None):
         self.state = SCANNING
         self.current_item = None
         self.line_number = 0
         self.item_list = []
         self.path = path
         self.base_depth = base_depth
-        with open(path, "r") as f:
-            try:
-                rows = f.readlines()
-            except:
-                raise Exception("couldn't read " + path)
-            for x in rows:
-                self.process_new_line(x)
+        if hits is None:
+            with open(path, "r") as f:
+                try:
+                    rows = f.readlines()
+                except:
+                    raise Exception("couldn't read " + path)
+                for x in rows:
+                    self.process_new_line(x)
+        else:
+            for line_number, line in hits:
+                if line_number != self.line_number + 1:
+                    self.finalize_current_item()
+                self.line_number = line_number - 1
+                self.process_new_line(line)
         self.finalize_current_item()
 
         
@@ -287,10 +309,110 @@ def should_explore_folder(folder_name, to_ignore):
 
 
 
+# !SUBSECTION! Scanning many files at once
+# ----------------------------------------
+
+# Instead of reading all the lines of each file in Python, we only
+# look at those that contain a "!" (there can't be an item in the
+# others), which the compiled engine finds on several threads if it
+# is available. The result for each file is stored in a cache along
+# with its modification time and size, so that unchanged files are
+# not read again when the tree is refreshed.
+
+def python_scan_file(path):
+    """Returns the list of the pairs (line number, line) of the lines
+    of the file at `path` that contain a "!", or `None` if it could
+    not be read. This is what `engine_scan_files` does when the
+    compiled engine is not available (it returns fewer lines, but
+    the items obtained from them are the same).
+
+    """
+    try:
+        with open(path, "r") as f:
+            return [(i+1, strip_final_newline(line))
+                    for i, line in enumerate(f.readlines())
+                    if "!" in line]
+    except:
+        return None
+
+
+def file_signature(path):
+    info = os.stat(path)
+    return (info.st_mtime_ns, info.st_size)
+
+
+class ScanCache:
+    """Remembers the lines returned by `scan_files` for each file,
+    along with the modification time and the size of the file. It is
+    stored in the pickle file at `path`.
+
+    """
+    def __init__(self, path):
+        self.path = path
+        self.entries = {}
+        self.modified = False
+        if os.path.isfile(path):
+            try:
+                with open(path, "rb") as f:
+                    self.entries = pickle.load(f)
+            except:
+                self.entries = {}
+
+    def get(self, file_path, signature):
+        key = os.path.abspath(file_path)
+        if key in self.entries and self.entries[key][0] == signature:
+            return self.entries[key][1]
+        return None
+
+    def put(self, file_path, signature, hits):
+        self.entries[os.path.abspath(file_path)] = (signature, hits)
+        self.modified = True
+
+    def save(self):
+        if not self.modified:
+            return
+        os.makedirs(os.path.dirname(self.path), exist_ok=True)
+        with open(self.path, "wb") as f:
+            pickle.dump(self.entries, f)
+        self.modified = False
+
+
+def scan_files(paths, cache=None, n_threads=0):
+    """Returns a dictionary mapping each path in `paths` to the lines
+    of the corresponding file that may contain an item (see
+    `ItemScanner`). The files are scanned in parallel by the compiled
+    engine if it is available, and those that did not change since
+    they were put in `cache` (a `ScanCache`) are not scanned again.
+
+    """
+    result = {}
+    to_scan, signatures = [], {}
+    for path in paths:
+        signature = file_signature(path)
+        if cache is not None:
+            hits = cache.get(path, signature)
+            if hits is not None:
+                result[path] = hits
+                continue
+        to_scan.append(path)
+        signatures[path] = signature
+    if engine_scan_files is not None:
+        scanned = engine_scan_files(to_scan, n_threads)
+    else:
+        scanned = [python_scan_file(path) for path in to_scan]
+    for path, hits in zip(to_scan, scanned):
+        if hits is None:
+            raise Exception("couldn't read " + path)
+        result[path] = hits
+        if cache is not None:
+            cache.put(path, signatures[path], hits)
+    return result
+
+
 # !SUBSECTION! Obtaining the items
 # --------------------------------
 
-def parse_file(path, depth):
+def parse_file(path, depth, hits=None):
     cursor = MeuporgItem(
         os.path.basename(path),
         path,
@@ -299,17 +421,54 @@ def parse_file(path, depth):
         depth
     )
     cursor.is_heading = True
-    for x in ItemScanner(path, depth):
+    for x in ItemScanner(path, depth, hits=hits):
         cursor = cursor.absorb_item(x)
     while cursor.depth > depth:
         cursor = cursor.predecessor
     return cursor
 
 
+def list_folder(folder_name, ignored_files, ignored_folders):
+    """Returns the lists of the files to parse and of the folders to
+    explore in the folder `folder_name`.
+
+    """
+    folders, files = [], []
+    with os.scandir(folder_name) as entries:
+        for entry in entries:
+            if entry.is_file():
+                if should_parse_file(entry.name, ignored_files):
+                    files.append(entry.name)
+            elif should_explore_folder(entry.name, ignored_folders):
+                folders.append(entry.name)
+    return files, folders
+
+
+def collect_files(folder_name, ignored_files, ignored_folders):
+    """Returns the paths of all the files that `parse_folder` parses."""
+    files, folders = list_folder(folder_name, ignored_files, ignored_folders)
+    result = [folder_name + file_name for file_name in files]
+    for subfolder_name in folders:
+        result += collect_files(folder_name + subfolder_name + "/",
+                                ignored_files,
+                                ignored_folders)
+    return result
+
+
 def parse_folder(folder_name,
                  depth,
                  ignored_files=None,
-                 ignored_folders=None):
+                 ignored_folders=None,
+                 hits=None,
+                 cache=None,
+                 n_threads=0):
+    """Returns the tree of the items in the folder `folder_name`.
+
+    All the files are first scanned at once (see `scan_files`,
+    which uses `cache` and `n_threads`), and `hits` is then the
+    dictionary it returned when parsing the subfolders.
+
+    """
     cursor = MeuporgItem(
         folder_name,
         folder_name,
@@ -328,19 +487,19 @@ def parse_folder(folder_name,
         with open(".projectile", "r") as f:
             for line in f.readlines():
                 to_ignore.append(re.compile(r"{}".format(line[2:])))
+    # scanning all the files in the tree
+    if hits == None:
+        hits = scan_files(collect_files(folder_name, ignored_files, ignored_folders),
+                          cache=cache,
+                          n_threads=n_threads)
     # finding all folders and files in the folder
-    folders, files = [], []
-    for entry in os.listdir(folder_name):
-        if os.path.isfile(folder_name + entry):
-            if should_parse_file(entry, ignored_files):
-                files.append(entry)
-        elif should_explore_folder(entry, ignored_folders):
-            folders.append(entry)
+    files, folders = list_folder(folder_name, ignored_files, ignored_folders)
     # parsing the files
     for file_name in files:
         cursor = cursor.absorb_item(parse_file(
             folder_name + file_name,
-            depth + 1
+            depth + 1,
+            hits=hits[folder_name + file_name]
         ))
     # parsing the folder
     for subfolder_name in folders:
@@ -349,6 +508,7 @@ def parse_folder(folder_name,
             depth + 1,
             ignored_files=ignored_files,
             ignored_folders=ignored_folders,
+            hits=hits
         ))
     while cursor.depth > depth:
         cursor = cursor.predecessor
@@ -461,6 +621,13 @@ if __name__ == "__main__":
                         type=int,
                         default=0,
                         help="The offset to add to the depth when displaying the org tree.")
+    parser.add_argument("-j", "--jobs",
+                        type=int,
+                        default=0,
+                        help="The number of threads scanning the files (defaults to the number of cores).")
+    parser.add_argument("--no-cache",
+                        action="store_true",
+                        help="Scans all the files, instead of only those modified since the last run")
     args = parser.parse_args()
 
     # !SUBSECTION! processing the folder (or file) 
@@ -470,12 +637,17 @@ if __name__ == "__main__":
             ign = []
         if args.path[-1] != "/":
             args.path += "/"
+        cache = None if args.no_cache else ScanCache(DEFAULT_CACHE_FILE)
         its = parse_folder(
             args.path,
             args.depth,
             ignored_files=STD_IGNORE_FILES + ign,
-            ignored_folders=STD_IGNORE_FOLDERS + ign
+            ignored_folders=STD_IGNORE_FOLDERS + ign,
+            cache=cache,
+            n_threads=args.jobs
         )
+        if cache is not None:
+            cache.save()
     else:
         its = parse_file(args.path, args.depth)
     print(format_MeuporgItem(its.top(),
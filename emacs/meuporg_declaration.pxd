@@ -0,0 +1,21 @@
+#!/usr/bin/env python3
+#-*- Python -*-
+# Time-stamp: <2026-10-14 09:14:34>
+
+
+from libcpp cimport bool
+from libcpp.vector cimport vector
+from libcpp.string cimport string
+from libc.stdint cimport uint64_t
+
+cdef extern from "meuporg_scanner.cpp" nogil:
+    cdef struct MeuporgHit:
+        uint64_t line_number
+        string line
+
+    cdef struct MeuporgFileScan:
+        bool readable
+        vector[MeuporgHit] hits
+
+    cdef vector[MeuporgFileScan] meuporg_scan_files(const vector[string] & paths,
+                                                    unsigned int n_threads)
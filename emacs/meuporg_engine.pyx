@@ -0,0 +1,38 @@
+#!/usr/bin/env python3
+#-*- Python -*-
+# Time-stamp: <2026-10-14 09:14:34>
+
+import os
+from meuporg_declaration cimport *
+
+
+def scan_files(paths, n_threads=0):
+    """Scans the files in the list `paths` in parallel, using
+    `n_threads` threads (0 meaning as many as there are cores).
+
+    Returns a list containing, for each file, either `None` if it
+    could not be read, or the list of the pairs (line number, line)
+    of the lines that may contain a meuporg item, which are those
+    containing a title such as "!TODO!" and those that contain a
+    "!" and follow such a line.
+
+    """
+    cdef vector[string] c_paths
+    for p in paths:
+        c_paths.push_back(os.fsencode(p))
+    cdef unsigned int c_threads = n_threads
+    cdef vector[MeuporgFileScan] scans
+    with nogil:
+        scans = meuporg_scan_files(c_paths, c_threads)
+    result = []
+    cdef size_t i, j
+    for i in range(0, scans.size()):
+        if not scans[i].readable:
+            result.append(None)
+            continue
+        hits = []
+        for j in range(0, scans[i].hits.size()):
+            hits.append((scans[i].hits[j].line_number,
+                         scans[i].hits[j].line.decode("UTF-8", "replace")))
+        result.append(hits)
+    return result
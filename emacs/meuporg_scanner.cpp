@@ -0,0 +1,163 @@
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+
+// !SECTION! Finding the lines that may contain items
+// ==================================================
+
+// A line is returned by the scanner (it is a "hit") if it may contain
+// a title such as "!TODO!", or if it contains a '!' and immediately
+// follows a hit (it may then continue an item). The regular
+// expressions of meuporg.py are then only applied on the hits: all
+// the other lines are neither titles nor continuations, so that
+// skipping them does not change the result.
+
+struct MeuporgHit
+{
+    uint64_t line_number;
+    std::string line;
+};
+
+
+struct MeuporgFileScan
+{
+    bool readable;
+    std::vector<MeuporgHit> hits;
+};
+
+
+// The \w of the Python regexps, where every non-ASCII byte is a word
+// character so that we find a superset of the titles matched in
+// Python (non-ASCII letters are encoded with such bytes in UTF-8).
+static inline bool meuporg_is_word(const unsigned char c)
+{
+    return ((c >= 'a') && (c <= 'z'))
+        || ((c >= 'A') && (c <= 'Z'))
+        || ((c >= '0') && (c <= '9'))
+        || (c == '_')
+        || (c >= 0x80);
+}
+
+
+// Returns true if [begin, end) contains a '!', followed by at least
+// one word character, followed by a '!'. `begin` must point to a '!'.
+static bool meuporg_may_have_title(const char * begin, const char * end)
+{
+    const char * bang = begin;
+    while (bang != NULL)
+    {
+        const char * cursor = bang + 1;
+        while ((cursor < end) && meuporg_is_word(*cursor))
+            cursor ++;
+        if (cursor >= end)
+            return false;
+        if ((*cursor == '!') && (cursor > bang + 1))
+            return true;
+        bang = (const char *)memchr(cursor, '!', end - cursor);
+    }
+    return false;
+}
+
+
+// The lines are only delimited when a '!' is found, which memchr
+// (vectorized by the libc) does much faster than we would by looking
+// at each byte. The line numbers are obtained by counting the '\n'
+// skipped in the meantime, which the compiler vectorizes as well.
+static void meuporg_scan_buffer(const char * data,
+                                const size_t size,
+                                std::vector<MeuporgHit> & hits)
+{
+    const char * end = data + size;
+    const char * position = data; // the beginning of a line
+    uint64_t line_number = 1, last_hit = 0;
+    while (position < end)
+    {
+        const char * bang = (const char *)memchr(position, '!', end - position);
+        if (bang == NULL)
+            break;
+        line_number += std::count(position, bang, '\n');
+        const char * line_begin = bang;
+        while ((line_begin > position) && (line_begin[-1] != '\n'))
+            line_begin --;
+        const char * line_end = (const char *)memchr(bang, '\n', end - bang);
+        if (line_end == NULL)
+            line_end = end;
+        if (((last_hit > 0) && (last_hit + 1 == line_number))
+            || meuporg_may_have_title(bang, line_end))
+        {
+            const char * stop = line_end;
+            if ((stop > line_begin) && (stop[-1] == '\r'))
+                stop --;
+            hits.push_back(MeuporgHit{line_number, std::string(line_begin, stop)});
+            last_hit = line_number;
+        }
+        if (line_end == end)
+            break;
+        position = line_end + 1;
+        line_number ++;
+    }
+}
+
+
+// !SECTION! Scanning files
+// ========================
+
+MeuporgFileScan meuporg_scan_file(const std::string & path)
+{
+    MeuporgFileScan result;
+    result.readable = false;
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return result;
+    struct stat info;
+    if (fstat(fd, &info) != 0)
+    {
+        close(fd);
+        return result;
+    }
+    result.readable = true;
+    if (info.st_size > 0)
+    {
+        void * data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED)
+            result.readable = false;
+        else
+        {
+            madvise(data, info.st_size, MADV_SEQUENTIAL);
+            meuporg_scan_buffer((const char *)data, info.st_size, result.hits);
+            munmap(data, info.st_size);
+        }
+    }
+    close(fd);
+    return result;
+}
+
+
+// The files are shared between the threads dynamically, as their
+// sizes vary a lot. `n_threads` equal to 0 means as many as OpenMP
+// would use.
+std::vector<MeuporgFileScan> meuporg_scan_files(const std::vector<std::string> & paths,
+                                                unsigned int n_threads)
+{
+    std::vector<MeuporgFileScan> result(paths.size());
+#ifdef _OPENMP
+    if (n_threads == 0)
+        n_threads = omp_get_max_threads();
+#else
+    n_threads = 1;
+#endif
+    #pragma omp parallel for schedule(dynamic, 16) num_threads(n_threads)
+    for (size_t i=0; i<paths.size(); i++)
+        result[i] = meuporg_scan_file(paths[i]);
+    return result;
+}
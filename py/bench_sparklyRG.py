@@ -0,0 +1,57 @@
+#!/usr/bin/sage
+
+import random
+import time
+from sparklyRG import *
+
+N = 10**5
+
+
+def per_output(f, n_outputs, repeat=5):
+    best = None
+    for r in range(0, repeat):
+        start = time.perf_counter()
+        f()
+        elapsed = time.perf_counter() - start
+        best = elapsed if best is None else min(best, elapsed)
+    return 1e9 * best / n_outputs
+
+
+prg = EschRG(b"benchmark")
+pool = SparklePool(prg)
+generators = prg.split(lanes())
+buffer = prg.fill(N, 64)
+
+rows = [
+    ("random.randint(0, 2**32)",
+     per_output(lambda : [random.randint(0, 2**32) for i in range(0, N)], N)),
+    ("prg(0, 2**32+1)",
+     per_output(lambda : [prg(0, 2**32+1) for i in range(0, N)], N)),
+    ("prg.get_n_bit_unsigned_integer(32)",
+     per_output(lambda : [prg.get_n_bit_unsigned_integer(32) for i in range(0, N)], N)),
+    ("prg.fill_in_range(N, 0, 2**32+1)",
+     per_output(lambda : prg.fill_in_range(N, 0, 2**32+1, out=buffer), N)),
+    ("prg.fill(N, 64)",
+     per_output(lambda : prg.fill(N, 64, out=buffer), N)),
+    ("fill_many(generators, N, 64)",
+     per_output(lambda : fill_many(generators, N, 64), N * len(generators))),
+    ("pool.fill(N, 64)",
+     per_output(lambda : pool.fill(N, 64, out=buffer), N)),
+    ("random.random()",
+     per_output(lambda : [random.random() for i in range(0, N)], N)),
+    ("prg.fill_uniform(N)",
+     per_output(lambda : prg.fill_uniform(N), N)),
+    ("random.gauss(0, 1)",
+     per_output(lambda : [random.gauss(0, 1) for i in range(0, N)], N)),
+    ("prg.fill_normal(N)",
+     per_output(lambda : prg.fill_normal(N), N)),
+    ("random.shuffle",
+     per_output(lambda : random.shuffle(list(range(0, N))), N)),
+    ("prg.random_permutation(N)",
+     per_output(lambda : prg.random_permutation(N, out=buffer), N)),
+]
+
+print("| {:40s} | {:>10s} |".format("operation", "ns/output"))
+print("|-")
+for name, t in rows:
+    print("| {:40s} | {:10.1f} |".format(name, t))
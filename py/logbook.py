@@ -1,11 +1,14 @@
 #!/usr/bin/env sage 
 #-*- Python -*-
-# Time-stamp: <2025-04-25 17:18:31> 
+# Time-stamp: <2026-10-14 09:45:47> 
 
 import datetime, time
 import sys, os
 import pickle
 import re
+import mmap
+import struct
+from collections.abc import Mapping, Sequence
 from rich.progress import Progress
 
 from collections import defaultdict
@@ -209,6 +212,47 @@ class MemTracer:
             memory_peak,
             pretty_peak
         )
+
+
+def sum_counters(generators):
+    """Returns the sum of the performance counters of the
+    `SparkleRG` instances in `generators` (see
+    `SparkleRG.counters`), or `None` if they were not compiled in.
+
+    """
+    result = None
+    for g in generators:
+        counters = g.counters()
+        if counters is None:
+            return None
+        if result is None:
+            result = {k: 0 for k in counters.keys()}
+        for k in counters.keys():
+            result[k] += counters[k]
+    return result
+
+
+class PRGCounters:
+    def __init__(self, generators, from_zero=False):
+        self.generators = generators[:]
+        self.start = None if from_zero else sum_counters(self.generators)
+
+    def elapsed(self):
+        current = sum_counters(self.generators)
+        if current is None or self.start is None:
+            return current
+        return {k: current[k] - self.start[k] for k in current.keys()}
+
+    def __str__(self):
+        elapsed = self.elapsed()
+        if elapsed is None:
+            return "no PRG counters (compile sparklyRG with SPARKLE512_COUNTERS=1)"
+        return "PRG: {} permutations, {} bits, {} rejections, {} cycles".format(
+            elapsed["permutations"],
+            elapsed["bits"],
+            elapsed["rejections"],
+            elapsed["cycles"]
+        )
         
 
 
@@ -274,6 +318,14 @@ class LogBook:
       the time and memory complexities of the program, as a well the
       number of results obtained. Defaults to True.
 
+    - `streaming`: if set to True, each event is appended to the file
+      as soon as it is logged (instead of at each new section), and
+      each entry put in the basket is immediately appended to a
+      binary basket file (see `BasketWriter`) instead of being kept
+      in memory and pickled at the end. Nothing is lost if the script
+      crashes, and the cost of logging does not grow with the number
+      of results. Defaults to False.
+
     Usage:
 
     The context defined when using this class defines contains new
@@ -293,6 +345,11 @@ class LogBook:
     - FAIL(content=None) like SUCCESS, but prints "[FAIL]" in
       red. Aslo increments a counter that is printed in the end.
 
+    - TRACK_GENERATORS(*generators) makes the LogBook record the
+      performance counters of these `SparkleRG` instances (if they
+      were compiled in) for each timed section, in the basket under
+      the key "prg_counters", and their total in the conclusion.
+
     - to_basket(x, identifier=None) will store x in a pickled file at
       the end of the execution, using either the provided identifier
       as a key. If no identifier is provided, then an increasing
@@ -344,6 +401,7 @@ class LogBook:
                  with_mem=False,
                  with_preamble=True,
                  with_conclusion=True,
+                 streaming=False,
                  ):
         # creating the directories needed if they don't exit yet
         try:
@@ -360,7 +418,12 @@ class LogBook:
             title
         ).replace(" ", "_")
         self.file_name = "logbooks/" + name + "." + print_format
-        self.basket_file = "baskets/" + name + ".pkl"
+        self.streaming = streaming
+        self.streaming_file = None
+        if self.streaming:
+            self.basket_file = "baskets/" + name + ".bsk"
+        else:
+            self.basket_file = "baskets/" + name + ".pkl"
         # setting up displaying infrastructure
         self.verbose = verbose
         self.current_toc_depth = 0
@@ -388,13 +451,17 @@ class LogBook:
         # initializing the state
         self.loop_depth = 0
         self.basket = {}
+        self.basket_sizes = {}
+        self.basket_writer = None
         self.story = []
         self.enum_counter = None
         self.investigated = None
         self.measurements = {
             "elapsed_time": {},
+            "prg_counters": {},
             "max_memory": None
         }
+        self.generators = []
         self.display = old_print
         # -- successes
         self.success_counter = 0
@@ -403,6 +470,8 @@ class LogBook:
         # -- file to write to
         with open(self.file_name, "w") as f:
             f.write("{}\n".format(self.pretty_title))
+        if self.streaming:
+            self.streaming_file = open(self.file_name, "a")
 
             
         
@@ -416,14 +485,22 @@ class LogBook:
                 elapsed = str(self.measurements["elapsed_time"][d])
                 self.log_to_basket("elapsed_time", elapsed, desc="t*")
                 del self.measurements["elapsed_time"][d]
+        for d in reversed(sorted(self.measurements["prg_counters"].keys())):
+            if d >= depth:
+                counters = self.measurements["prg_counters"][d].elapsed()
+                if counters is not None:
+                    self.log_to_basket("prg_counters", counters, desc="t*")
+                del self.measurements["prg_counters"][d]
         # adding to the story
-        self.story.append({
+        self.add_to_story({
             "content": heading,
             "type": "head" + str(depth)
         })
         # starting a timer if necessary
         if with_timer:
             self.measurements["elapsed_time"][depth] = Chronograph(heading)
+            if len(self.generators) > 0:
+                self.measurements["prg_counters"][depth] = PRGCounters(self.generators)
         self.current_toc_depth = depth
         if self.verbose:
             line = "{}{} {}".format(
@@ -499,17 +576,39 @@ class LogBook:
                                                    input_for_print(full_event["content"])),
                                      style))
         full_event["content"] = prefix_text + input_for_print(full_event["content"])
-        self.story.append(full_event)
+        self.add_to_story(full_event)
+
+
+    def add_to_story(self, entry):
+        self.story.append(entry)
+        if self.streaming_file is not None:
+            self.save_to_file()
 
             
     def log_to_basket(self, key, entry, desc="t"):
-        if key in self.basket.keys():
+        if self.streaming and self.basket_writer is None:
+            # the basket file is only created once there is something
+            # to put in it
+            self.basket_writer = BasketWriter(self.basket_file)
+        if self.basket_writer is not None:
+            self.basket_writer.append(key, entry)
+        elif key in self.basket.keys():
             self.basket[key].append(entry)
         else:
             self.basket[key] = [entry]
+        self.basket_sizes[key] = self.basket_sizes.get(key, 0) + 1
         self.log_event("{}: {}".format(key, entry), desc=desc)
 
 
+    def track_generators(self, *generators):
+        """Adds the `SparkleRG` instances in `generators` to those
+        whose performance counters are recorded for each timed
+        section started afterwards.
+
+        """
+        self.generators += list(generators)
+
+
     def log_success(self, *args):
         self.care_about_success_or_fail = True
         text = [x for x in args]
@@ -536,38 +635,46 @@ class LogBook:
     # !SUBSECTION! Writing story to file 
         
     def save_to_file(self):
-        with open(self.file_name, "a") as f:
-            for line in self.story:
-                if "type" not in line.keys():
-                    raise Exception(
-                        "error: a story line doesn't have a type (story line: {})".format(line)
-                    )
-                elif line["type"][:4] == "head":
-                    depth = int(line["type"][4:], 10)
-                    f.write("{}{} {}\n".format(
-                        "\n\n" if depth == 1 else "",                
-                        self.headings(depth),
-                        line["content"]
-                    ))
-                elif line["type"][:4] == "enum":
-                    depth = int(line["type"][4:], 10)
-                    f.write("{}. {} {}\n".format(
-                        depth,
-                        line["tstamp"],
-                        line["content"]
-                    ))
-                elif line["type"] == "list":
-                    f.write("{} {}{}\n".format(
-                        self.bullet,
-                        line["tstamp"],
-                        line["content"]
-                    ))
-                else:
-                    f.write("{}{}\n".format(
-                        line["tstamp"],
-                        line["content"]
-                    ))
-            self.story = []
+        if self.streaming_file is not None:
+            self.write_story(self.streaming_file)
+            self.streaming_file.flush()
+        else:
+            with open(self.file_name, "a") as f:
+                self.write_story(f)
+
+
+    def write_story(self, f):
+        for line in self.story:
+            if "type" not in line.keys():
+                raise Exception(
+                    "error: a story line doesn't have a type (story line: {})".format(line)
+                )
+            elif line["type"][:4] == "head":
+                depth = int(line["type"][4:], 10)
+                f.write("{}{} {}\n".format(
+                    "\n\n" if depth == 1 else "",                
+                    self.headings(depth),
+                    line["content"]
+                ))
+            elif line["type"][:4] == "enum":
+                depth = int(line["type"][4:], 10)
+                f.write("{}. {} {}\n".format(
+                    depth,
+                    line["tstamp"],
+                    line["content"]
+                ))
+            elif line["type"] == "list":
+                f.write("{} {}{}\n".format(
+                    self.bullet,
+                    line["tstamp"],
+                    line["content"]
+                ))
+            else:
+                f.write("{}{}\n".format(
+                    line["tstamp"],
+                    line["content"]
+                ))
+        self.story = []
 
 
     # !SUBSECTION! The functions needed by the "with" logic
@@ -634,17 +741,21 @@ class LogBook:
                     str(self.measurements["max_memory"]),
                     desc="l*"
                 )
+            # handling the cost of the PRGs
+            if len(self.generators) > 0:
+                self.log_event(str(PRGCounters(self.generators, from_zero=True)),
+                               desc="l*")
             # handling results in the logbook itself
             self.section(2, "Outcome")
-            if len(self.basket.keys()) == 0:
+            if len(self.basket_sizes.keys()) == 0:
                 basket_description = "basket is empty"
             else:
                 basket_description = "basket was filled"
             self.section(3, basket_description)
-            for k in self.basket.keys():
+            for k in self.basket_sizes.keys():
                 self.display("{} {}: {}".format(self.bullet,
                                                 k,
-                                                len(self.basket[k])))
+                                                self.basket_sizes[k]))
             if self.care_about_success_or_fail:
                 self.section(3, "Successes and Failures")
                 total = self.success_counter + self.fail_counter
@@ -663,15 +774,26 @@ class LogBook:
                     )
                 self.display(line)
         # storing the results
-        if len(self.basket.keys()) > 0:
-            self.basket["title"] = self.title
-            self.basket["finished at"] = time_stamp()
-            self.basket["file name"] = self.basket_file
-            archive_basket(self.basket, self.basket_file)
+        if len(self.basket_sizes.keys()) > 0:
+            if self.basket_writer is not None:
+                self.basket_writer.set("title", self.title)
+                self.basket_writer.set("finished at", time_stamp())
+                self.basket_writer.set("file name", self.basket_file)
+            else:
+                self.basket["title"] = self.title
+                self.basket["finished at"] = time_stamp()
+                self.basket["file name"] = self.basket_file
+                archive_basket(self.basket, self.basket_file)
             self.section(2, "Basket written to {}".format(
                 self.basket_file
             ))
         self.save_to_file()
+        if self.streaming:
+            self.streaming_file.close()
+            self.streaming_file = None
+            if self.basket_writer is not None:
+                self.basket_writer.close()
+                self.basket_writer = None
         # undoing global modifications
         builtins.print = old_print
         ONGOING_LOGBOOK = None
@@ -736,6 +858,9 @@ def PARAGRAPH(heading, timed=False):
 def to_basket(key, entry, desc="t*"):
     ONGOING_LOGBOOK.log_to_basket(key, entry, desc=desc)
 
+def TRACK_GENERATORS(*generators):
+    ONGOING_LOGBOOK.track_generators(*generators)
+
 
 # !SUBSUBSECTION!  Pretty loop
 
@@ -769,10 +894,133 @@ def archive_basket(results, file_name):
 
 
 def open_basket(file):
+    if file.endswith(".bsk"):
+        return BinaryBasket(file)
     with open(file, "rb") as f:
         return pickle.load(f)
 
 
+# !SUBSECTION! Binary baskets
+
+# A binary basket (written by a LogBook in streaming mode) is a
+# sequence of records appended one after the other, so that writing
+# an entry does not require rewriting what was already written, and
+# that a basket whose writing was interrupted (say, by a crash) is
+# still readable up to its last complete record. The file starts with
+# BASKET_MAGIC, and each record consists of:
+# - a header: its kind (BASKET_APPEND or BASKET_SET), the length of
+#   the key and the length of the entry, as packed by BASKET_HEADER;
+# - the key, then the entry, both pickled.
+# A BASKET_APPEND record appends its entry to the list of the entries
+# of its key, while a BASKET_SET one sets the value of its key (used
+# for the title, etc.).
+
+BASKET_MAGIC  = b"LBBASKT1"
+BASKET_APPEND = b"A"
+BASKET_SET    = b"S"
+BASKET_HEADER = struct.Struct("<cIQ")
+
+
+class BasketWriter:
+    def __init__(self, file_name):
+        self.file = open(file_name, "wb")
+        self.file.write(BASKET_MAGIC)
+        self.file.flush()
+
+    def write(self, kind, key, entry):
+        pickled_key = pickle.dumps(key)
+        pickled_entry = pickle.dumps(entry)
+        self.file.write(BASKET_HEADER.pack(kind, len(pickled_key), len(pickled_entry))
+                        + pickled_key
+                        + pickled_entry)
+        self.file.flush()
+
+    def append(self, key, entry):
+        self.write(BASKET_APPEND, key, entry)
+
+    def set(self, key, entry):
+        self.write(BASKET_SET, key, entry)
+
+    def close(self):
+        self.file.close()
+
+
+class LazyEntries(Sequence):
+    """The entries of a key in a `BinaryBasket`: they are only
+    unpickled when accessed.
+
+    """
+    def __init__(self, data, locations):
+        self.data = data
+        self.locations = locations
+
+    def __len__(self):
+        return len(self.locations)
+
+    def __getitem__(self, i):
+        if isinstance(i, slice):
+            return [self[j] for j in range(*i.indices(len(self)))]
+        start, length = self.locations[i]
+        return pickle.loads(self.data[start:start+length])
+
+
+class BinaryBasket(Mapping):
+    """A read-only dictionary-like view of a binary basket. The file
+    is memory-mapped, and only its record headers and keys are read
+    when it is opened: `basket[key]` returns a `LazyEntries`, so that
+    grabbing one result from a huge basket does not require loading
+    all of them. `to_dict()` loads everything into a regular
+    dictionary, as `open_basket` returns for pickled baskets.
+
+    """
+    def __init__(self, file_name):
+        with open(file_name, "rb") as f:
+            if os.fstat(f.fileno()).st_size == 0:
+                raise Exception("{} is empty".format(file_name))
+            self.data = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+        if self.data[:len(BASKET_MAGIC)] != BASKET_MAGIC:
+            raise Exception("{} is not a binary basket".format(file_name))
+        self.entries = {}
+        self.values = {}
+        position = len(BASKET_MAGIC)
+        while position + BASKET_HEADER.size <= len(self.data):
+            kind, key_length, entry_length = BASKET_HEADER.unpack_from(self.data, position)
+            start = position + BASKET_HEADER.size
+            end = start + key_length + entry_length
+            if end > len(self.data): # the last record is incomplete
+                break
+            key = pickle.loads(self.data[start:start+key_length])
+            location = (start + key_length, entry_length)
+            if kind == BASKET_SET:
+                self.values[key] = location
+            else:
+                self.entries.setdefault(key, []).append(location)
+            position = end
+
+    def __getitem__(self, key):
+        if key in self.values:
+            start, length = self.values[key]
+            return pickle.loads(self.data[start:start+length])
+        return LazyEntries(self.data, self.entries[key])
+
+    def __iter__(self):
+        for key in self.entries.keys():
+            yield key
+        for key in self.values.keys():
+            if key not in self.entries:
+                yield key
+
+    def __len__(self):
+        return len(self.entries.keys() | self.values.keys())
+
+    def to_dict(self):
+        result = {}
+        for key in self.keys():
+            entry = self[key]
+            result[key] = list(entry) if isinstance(entry, LazyEntries) else entry
+        return result
+
+
 def grab_last_basket(*args):
     filters = []
     for x in args:
@@ -1,33 +1,30 @@
 #!/usr/bin/sage
 #-*- Python -*-
-# Time-stamp: <2024-08-08 17:24:29 leo>
+# Time-stamp: <2026-10-14 09:45:32 leo>
 
 
-import hashlib
 import time
 import os
-import ctypes
 
-from math import log, ceil
-from copy import copy
+from .sparklyRG import EschRG
 
-from .cpputils import *
 
-
-# !TODO! rewrite documentation to take into account the move to SPARKLE512
-
-# !TODO! allow outputting random functions and random permutations 
-
-class ReproduciblePRG:
+class ReproduciblePRG(EschRG):
     """A simple pseudo random number generator based on a simplified
     version of SPARKLE512 (fewer rounds, bigger rate).
 
+    It is an `EschRG` with a slightly different interface (a default
+    range, and a `seed` attribute), so that it relies on the same C++
+    core: it has all the bulk functions of `SparkleRG` (`fill`,
+    `fill_in_range`, `random_permutation`, ...), and a given seed
+    yields the same outputs with both classes.
+
     """
     def __init__(self, seed):
         """Initializing the SPARKLE-based PRNG
 
         """
-        self.edf = PySparkle512EDF()
+        EschRG.__init__(self, [])
         self.seed = []
         self.reseed(seed)
 
@@ -35,10 +32,14 @@ class ReproduciblePRG:
         if isinstance(seed, list):
             self.seed += seed
             for x in seed:
-                self.edf.absorb(x)
+                self._absorb_block(x)
         else:
             self.seed.append(seed)
-            self.edf.absorb(seed)
+            self._absorb_block(seed)
+
+    def _record_id(self, i):
+        EschRG._record_id(self, i)
+        self.seed.append(i)
         
 
     def reseed_from_time_and_pid(self):
@@ -69,8 +70,8 @@ class ReproduciblePRG:
 
         We use rejection sampling, so if the value range
         (upper_bound-lower_bound) is just above a power of 2 then we
-        might need to recursively call this function up to twice on
-        average before actually getting a valid output.
+        might need up to two attempts on average before actually
+        getting a valid output. They all happen in the C++ core.
 
         """
         if lower_bound >= upper_bound:
@@ -79,16 +80,7 @@ class ReproduciblePRG:
                     upper_bound,
                     lower_bound
                 ))
-        value_range = upper_bound - lower_bound
-        bit_length = ceil(log(value_range, 2))
-        alea = self.edf.get_n_bit_unsigned_integer(bit_length)
-        potential_output = lower_bound + alea
-        # rejection sampling
-        if potential_output < upper_bound:
-            return potential_output
-        else:
-            return self(lower_bound=lower_bound,
-                        upper_bound=upper_bound)
+        return EschRG.__call__(self, lower_bound, upper_bound)
 
 
     def __str__(self):
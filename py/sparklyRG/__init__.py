@@ -1,5 +1,6 @@
 from .wrapper import *
 import datetime
+import copy
     
 
 class EschRG(SparkleRG):
@@ -23,6 +24,7 @@ class EschRG(SparkleRG):
         """
         SparkleRG.__init__(self, 8, 256)
         self.absorbed = []
+        self.forks = []
         blocks = []
         if isinstance(seeds, list):
             blocks = seeds[:]
@@ -34,7 +36,11 @@ class EschRG(SparkleRG):
         for x in blocks:
             self._absorb_block(x)        
     def __str__(self):
-        return "EschRG({})".format(self.absorbed)  
+        path = "".join(".fork({})".format(i) for i in getattr(self, "forks", []))
+        return "EschRG({}){}".format(self.absorbed, path)
+    
+    def _record_fork(self, index):
+        self.forks = getattr(self, "forks", []) + [index]  
     def _absorb_block(self, x):
         """Absorbs `x` into the state, performing some boring
         operations along the way to handle inputs of different
@@ -47,22 +53,61 @@ class EschRG(SparkleRG):
             to_absorb = x.encode("UTF-8")
         else:
             to_absorb = str(x).encode("UTF-8")
+        self.absorbed.append(to_absorb)
         if len(to_absorb) > 31:
-                raise Exception("block is too big, max length is 31 bytes")
+            self.absorb_update(to_absorb)
+            self.absorb_final()
         else:
-            self.absorbed.append(to_absorb)
             self.absorb(to_absorb)        
-    def random_permutation(self, v_size):
-        """Returns the set of integers {0,...,v_size-1} after
-        undergoing a permutation picked uniformly at random.
     
-        Relies on a Fisher-Yates shuffle to do so.
+    def numpy_generator(self):
+        """Returns a `numpy.random.Generator` whose outputs are derived
+        from those that this instance would produce (it is itself not
+        modified), e.g. `EschRG(b"seed").numpy_generator().normal(size=10)`.
+    
+        """
+        import numpy
+        from .bitgen import SparkleBitGenerator
+        return numpy.random.Generator(SparkleBitGenerator(self))
+    
+    @classmethod
+    def batch(cls, seeds, ids):
+        """Returns an `EschRGBatch` `b` such that `b[j]` is identical to
+        `EschRG(seeds + [ids[j]])` (or `EschRG([seeds, ids[j]])` if
+        `seeds` is not a list), `ids` being a list, a `range` or a
+        buffer of non-negative 64-bit integers.
+    
+        """
+        return EschRGBatch(cls(seeds), ids)
     
-        https://en.wikipedia.org/wiki/Fisher%E2%80%93Yates_shuffle
+    def _record_id(self, i):
+        """Updates the attributes describing the seeds as if `i` had been
+        absorbed by `_absorb_block` (used by `EschRGBatch`, which absorbs
+        it in C++).
     
         """
-        result = list(range(0, v_size))
-        for i in range(0, v_size):
-            j = self(i, v_size)
-            result[i], result[j] = result[j], result[i]
+        self.absorbed.append(str(i).encode("UTF-8"))
+
+
+class EschRGBatch:
+    """The instances returned by `EschRG.batch`."""
+    def __init__(self, base, ids):
+        self.base_class = type(base)
+        self.base_attributes = dict(vars(base))
+        self.ids = ids
+        self.cores = base.absorb_ids(ids)
+
+    def __len__(self):
+        return len(self.cores)
+
+    def __getitem__(self, j):
+        result = self.base_class.__new__(self.base_class)
+        for name, value in self.base_attributes.items():
+            setattr(result, name, copy.copy(value))
+        self.cores.copy_into(j, result)
+        result._record_id(self.ids[j])
         return result
+
+    def __iter__(self):
+        for j in range(0, len(self)):
+            yield self[j]
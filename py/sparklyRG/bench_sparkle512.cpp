@@ -0,0 +1,172 @@
+#include "sparkle512.cpp"
+#include<chrono>
+#include<cstdio>
+#if defined(__x86_64__) || defined(__i386__)
+#include<x86intrin.h>
+#define BENCH_TICKS() __rdtsc()
+#else
+#define BENCH_TICKS() ((uint64_t)0)
+#endif
+
+static volatile uint64_t bench_sink;
+
+struct BenchResult
+{
+    double ns;
+    double ticks;
+};
+
+template<typename F>
+BenchResult bench(F f, const size_t iterations)
+{
+    f(); // warm-up
+    const auto start = std::chrono::steady_clock::now();
+    const uint64_t start_ticks = BENCH_TICKS();
+    for (size_t i=0; i<iterations; i++)
+        f();
+    const uint64_t end_ticks = BENCH_TICKS();
+    const auto end = std::chrono::steady_clock::now();
+    return {
+        std::chrono::duration<double, std::nano>(end - start).count() / iterations,
+        ((double)(end_ticks - start_ticks)) / iterations
+    };
+}
+
+// `elements` is the number of outputs of each call, each being
+// `bytes` long
+static void report(const char * name,
+                   const BenchResult r,
+                   const double elements,
+                   const double bytes)
+{
+    printf("| %-44s | %10.2f | %10.1f | %8.2f |\n",
+           name,
+           r.ns / elements,
+           r.ticks / elements,
+           r.ticks / (elements * bytes));
+}
+
+static Sparkle512core seeded_core(const unsigned int steps,
+                                  const unsigned int rate,
+                                  const uint8_t seed)
+{
+    Sparkle512core result;
+    result.setup(steps, rate);
+    result.absorb(&seed, 1);
+    return result;
+}
+
+#define BENCH_ITERATIONS 1000000
+#define BENCH_BULK_SIZE  4096
+#define BENCH_RATE       256
+
+static void bench_sponge()
+{
+    char name[64];
+    for (unsigned int steps : {7, 8, 10, 12})
+    {
+        Sparkle512core core = seeded_core(steps, BENCH_RATE, 0);
+        snprintf(name, sizeof(name), "_permute (%u steps)", steps);
+        report(name, bench([&]() { core._permute(); }, BENCH_ITERATIONS), 1, BENCH_RATE/8);
+    }
+    for (unsigned int mode : {SQUEEZE_PARITY, SQUEEZE_COPY})
+    {
+        Sparkle512core core;
+        core.setup(8, BENCH_RATE, mode);
+        snprintf(name, sizeof(name), "_squeeze (%s)", mode == SQUEEZE_PARITY ? "parity" : "copy");
+        report(name, bench([&]() { core._squeeze(); }, BENCH_ITERATIONS), 1, BENCH_RATE/8);
+    }
+}
+
+static void bench_single_outputs()
+{
+    char name[64];
+    for (unsigned int n=1; n<=64; n++)
+    {
+        Sparkle512core core = seeded_core(8, BENCH_RATE, 1);
+        snprintf(name, sizeof(name), "get_n_bit_unsigned_integer(%u)", n);
+        report(name,
+               bench([&]() { bench_sink = core.get_n_bit_unsigned_integer(n); },
+                     BENCH_ITERATIONS),
+               1,
+               n / 8.0);
+    }
+    for (unsigned int mode : {RANGE_REJECTION, RANGE_MULTIPLY})
+        for (unsigned int k : {8, 16, 32, 48, 62})
+        {
+            Sparkle512core core = seeded_core(8, BENCH_RATE, 2);
+            core.set_range_mode(mode);
+            const uint64_t upper = (((uint64_t)1) << k) + 1;
+            snprintf(name, sizeof(name), "get_unsigned_integer_in_range(2^%u+1, %s)",
+                     k, mode == RANGE_REJECTION ? "rej." : "mul.");
+            report(name,
+                   bench([&]() { bench_sink = core.get_unsigned_integer_in_range(0, upper); },
+                         BENCH_ITERATIONS),
+                   1,
+                   (k + 1) / 8.0);
+        }
+}
+
+static void bench_bulk()
+{
+    const size_t iterations = BENCH_ITERATIONS / BENCH_BULK_SIZE;
+    std::vector<uint64_t> out(BENCH_BULK_SIZE * Sparkle512core::lanes());
+    std::vector<double> real_out(BENCH_BULK_SIZE);
+    Sparkle512core core = seeded_core(8, BENCH_RATE, 3);
+    report("fill(64)",
+           bench([&]() { core.fill(out.data(), BENCH_BULK_SIZE, 64); }, iterations),
+           BENCH_BULK_SIZE, 8);
+    report("fill(8)",
+           bench([&]() { core.fill(out.data(), BENCH_BULK_SIZE, 8); }, iterations),
+           BENCH_BULK_SIZE, 1);
+    report("fill_in_range(2^32+1)",
+           bench([&]() { core.fill_in_range(out.data(), BENCH_BULK_SIZE, 0, (((uint64_t)1) << 32) + 1); },
+                 iterations),
+           BENCH_BULK_SIZE, 33 / 8.0);
+    report("random_permutation",
+           bench([&]() { core.random_permutation(out.data(), BENCH_BULK_SIZE, false); }, iterations),
+           BENCH_BULK_SIZE, 8);
+    report("random_permutation (batched)",
+           bench([&]() { core.random_permutation(out.data(), BENCH_BULK_SIZE, true); }, iterations),
+           BENCH_BULK_SIZE, 8);
+    report("fill_normal",
+           bench([&]() { core.fill_normal(real_out.data(), BENCH_BULK_SIZE, 0, 1); }, iterations),
+           BENCH_BULK_SIZE, 8);
+
+    const unsigned int n_lanes = Sparkle512core::lanes();
+    std::vector<Sparkle512core> cores(n_lanes);
+    std::vector<Sparkle512core*> pointers(n_lanes);
+    for (unsigned int l=0; l<n_lanes; l++)
+    {
+        cores[l] = seeded_core(8, BENCH_RATE, l);
+        pointers[l] = &cores[l];
+    }
+    report("permute_many (per permutation)",
+           bench([&]() { Sparkle512core::permute_many(pointers.data(), n_lanes); }, iterations),
+           n_lanes, BENCH_RATE/8);
+    report("fill_many(64)",
+           bench([&]() { Sparkle512core::fill_many(pointers.data(), n_lanes, out.data(), BENCH_BULK_SIZE, 64); },
+                 iterations),
+           n_lanes * BENCH_BULK_SIZE, 8);
+    report("split (per child)",
+           bench([&]() { core.split(cores.data(), n_lanes); }, iterations),
+           n_lanes, BENCH_RATE/8);
+
+    Sparkle512pool pool;
+    pool.setup(core, Sparkle512pool::max_threads());
+    const size_t pool_size = 64 * BENCH_BULK_SIZE;
+    std::vector<uint64_t> pool_out(pool_size);
+    report("Sparkle512pool::fill(64)",
+           bench([&]() { pool.fill(pool_out.data(), pool_size, 64); }, iterations),
+           pool_size, 8);
+}
+
+int main()
+{
+    printf("| %-44s | %10s | %10s | %8s |\n", "function", "ns/output", "ticks/out", "ticks/B");
+    printf("|-\n");
+    bench_sponge();
+    bench_single_outputs();
+    bench_bulk();
+    return 0;
+}
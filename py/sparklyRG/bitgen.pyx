@@ -0,0 +1,88 @@
+from declaration cimport *
+from cpython.pycapsule cimport PyCapsule_New
+from numpy.random cimport BitGenerator, bitgen_t
+
+
+cdef uint64_t _next_uint64(void * core) noexcept nogil:
+    return (<Sparkle512core *>core).get_n_bit_unsigned_integer(64)
+
+
+cdef uint32_t _next_uint32(void * core) noexcept nogil:
+    return <uint32_t>(<Sparkle512core *>core).get_n_bit_unsigned_integer(32)
+
+
+cdef double _next_double(void * core) noexcept nogil:
+    return (<Sparkle512core *>core).get_uniform_double()
+
+
+cdef class SparkleBitGenerator(BitGenerator):
+    cdef Sparkle512core * core
+
+    def __cinit__(self):
+        self.core = new Sparkle512core()
+
+
+    def __dealloc__(self):
+        del self.core
+
+
+    def __init__(self, generator):
+        """Returns a `numpy` bit generator producing the outputs
+        that `generator` (a `SparkleRG` instance) would produce,
+        which is left untouched. It is meant to be used as
+        `numpy.random.Generator(SparkleBitGenerator(generator))`.
+        `generator` can also be a dictionary obtained from the
+        `state` attribute of another instance.
+
+        """
+        BitGenerator.__init__(self, 0)
+        if isinstance(generator, dict):
+            self.state = generator
+        elif hasattr(generator, "save_state"):
+            self.state = {"bit_generator": type(self).__name__,
+                          "state": generator.save_state()}
+        else:
+            raise TypeError("generator must be a SparkleRG instance or a state dict")
+        self._bitgen.state = <void *>self.core
+        self._bitgen.next_uint64 = &_next_uint64
+        self._bitgen.next_uint32 = &_next_uint32
+        self._bitgen.next_double = &_next_double
+        self._bitgen.next_raw = &_next_uint64
+        self.capsule = PyCapsule_New(<void *>&self._bitgen, "BitGenerator", NULL)
+
+
+    @property
+    def state(self):
+        """The state of the core, as a dictionary in the format of
+        `numpy`, its "state" entry being the blob returned by
+        `save_state`.
+
+        """
+        cdef vector[uint8_t] blob = self.core.save_state()
+        return {"bit_generator": type(self).__name__,
+                "state": (<const char *>blob.data())[:blob.size()]}
+
+
+    @state.setter
+    def state(self, value):
+        cdef const uint8_t[::1] blob
+        cdef Sparkle512core loaded
+        if not isinstance(value, dict) or "state" not in value:
+            raise TypeError("state must be a dict with a 'state' entry")
+        if value.get("bit_generator") != type(self).__name__:
+            raise ValueError("state must be for a {} PRNG".format(type(self).__name__))
+        blob = value["state"]
+        if blob.shape[0] == 0:
+            raise ValueError("state must not be empty")
+        loaded.load_state(&blob[0], blob.shape[0])
+        if loaded.output_rate() == 0:
+            raise ValueError("state must be that of a generator that was set up")
+        self.core[0] = loaded
+
+
+    def __reduce__(self):
+        return (_restore_bit_generator, (type(self), self.state))
+
+
+def _restore_bit_generator(cls, state):
+    return cls(state)
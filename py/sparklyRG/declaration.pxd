@@ -1,11 +1,100 @@
 from libcpp.vector cimport vector
-from libc.stdint cimport uint64_t, uint8_t
+from libcpp cimport bool
+from libc.stdint cimport uint64_t, uint32_t, uint16_t, uint8_t
+
+cdef extern from "./sparkle512.cpp" nogil:
+    cdef struct Sparkle512counters:
+        uint64_t permutations
+        uint64_t bits
+        uint64_t rejections
+        uint64_t cycles
 
-cdef extern from "./sparkle512.cpp":
     cdef cppclass Sparkle512core:
         Sparkle512core() except +
-        void setup(const unsigned int steps, const unsigned int)
-        void absorb(const vector[uint8_t])
+        void setup(const unsigned int steps, const unsigned int) except +
+        void setup(const unsigned int steps,
+                   const unsigned int output_rate,
+                   const unsigned int squeeze_mode) except +
+        void set_range_mode(const unsigned int mode) except +
+        unsigned int output_rate()
+        void absorb(const uint8_t * byte_array, const size_t length) except +
+        void absorb(const vector[uint8_t] & byte_array) except +
+        void absorb_update(const uint8_t * bytes, const size_t length)
+        void absorb_file(const char * path) except +
+        void absorb_final()
+        void fork(const uint64_t index, Sparkle512core * child)
+        void split(Sparkle512core * children, const size_t k)
+        void absorb_ids(Sparkle512core * children,
+                        const uint64_t * ids,
+                        const size_t k)
+        void start_counter_mode()
+        void seek(const uint64_t block_index)
+        void fill_blocks(uint32_t * out,
+                         const uint64_t first_block,
+                         const size_t n_blocks) except +
+        vector[uint8_t] save_state()
+        void load_state(const uint8_t * blob, const size_t length) except +
+        Sparkle512counters get_counters()
+        void reset_counters()
+        @staticmethod
+        bool counters_enabled()
         uint64_t get_n_bit_unsigned_integer(const unsigned int n)
         uint64_t get_unsigned_integer_in_range(const uint64_t lower,
                                                const uint64_t upper)
+        void fill(uint64_t * out, const size_t count, const unsigned int n)
+        void fill_in_range(uint64_t * out,
+                           const size_t count,
+                           const uint64_t lower,
+                           const uint64_t upper)
+        @staticmethod
+        void fill_many(Sparkle512core ** cores,
+                       const size_t n_cores,
+                       uint64_t * out,
+                       const size_t count,
+                       const unsigned int n)
+        @staticmethod
+        unsigned int lanes()
+        void shuffle[T](T * data, const size_t n)
+        void shuffle_batched[T](T * data, const size_t n)
+        void random_permutation(uint64_t * out, const size_t n, const bint batched)
+        void random_subset(uint64_t * out, const uint64_t n, const size_t k)
+        void random_sorted_subset(uint64_t * out, const uint64_t n, const size_t k)
+        void random_functions[T](T * out,
+                                 const size_t n_tables,
+                                 const unsigned int in_bits,
+                                 const unsigned int out_bits)
+        void random_sboxes[T](T * out, const size_t n_tables, const unsigned int n_bits)
+        void random_bit_matrix(uint64_t * out, const size_t rows, const size_t cols)
+        void random_invertible_bit_matrix(uint64_t * out, const size_t n)
+        double get_uniform_double()
+        double get_normal()
+        double get_exponential()
+        bool get_bernoulli(const double p)
+        uint64_t get_binomial(const uint64_t trials, const double p)
+        void fill_uniform(double * out, const size_t count)
+        void fill_normal(double * out,
+                         const size_t count,
+                         const double mean,
+                         const double stddev)
+        void fill_exponential(double * out, const size_t count, const double rate)
+        void fill_bernoulli(uint8_t * out, const size_t count, const double p)
+        void fill_binomial(uint64_t * out,
+                           const size_t count,
+                           const uint64_t trials,
+                           const double p)
+
+
+cdef extern from "./sparkle512.cpp" nogil:
+    unsigned int SPARKLE512_MAX_STEPS
+
+    cdef cppclass Sparkle512pool:
+        Sparkle512pool() except +
+        void setup(const Sparkle512core & parent, const unsigned int n_threads)
+        unsigned int n_threads()
+        void fill(uint64_t * out, const size_t count, const unsigned int n)
+        void fill_in_range(uint64_t * out,
+                           const size_t count,
+                           const uint64_t lower,
+                           const uint64_t upper)
+        @staticmethod
+        unsigned int max_threads()
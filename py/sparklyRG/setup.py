@@ -21,6 +21,9 @@ else:
     extra_compile_args += ['-fopenmp']
     extra_link_args += ['-fopenmp']
 
+if os.environ.get("SPARKLE512_COUNTERS", "0") != "0":
+    extra_compile_args += ['-DSPARKLE512_COUNTERS']
+
 
 
 module_sparklyRG = Extension("wrapper",
@@ -32,4 +35,19 @@ module_sparklyRG = Extension("wrapper",
                              extra_compile_args=extra_compile_args)
 
 
-setup(name='wrapper', ext_modules=cythonize([module_sparklyRG], language_level = "3"))
+modules = [module_sparklyRG]
+
+try:
+    import numpy
+    modules.append(Extension("bitgen",
+                             sources=["bitgen.pyx"],
+                             libraries=[],
+                             include_dirs=['.', numpy.get_include()],
+                             language='c++',
+                             extra_link_args=extra_link_args,
+                             extra_compile_args=extra_compile_args))
+except ImportError:
+    pass
+
+
+setup(name='wrapper', ext_modules=cythonize(modules, language_level = "3"))
@@ -1,108 +1,543 @@
-#include "sparkle512.hpp"
+#include "sparkle512.hpp"  
+#include<string>
+#include<stdexcept>
+#include<fcntl.h>
+#include<unistd.h>
+#include<sys/mman.h>
+#include<sys/stat.h>
+#include<cmath>
+#include<unordered_set>
 
+SPARKLE512_INLINE
 Sparkle512core::Sparkle512core():
-    steps(0),
     state{{0}},
-    entropy_tank(0, false),
-    entropy_cursor(0) {}
+    entropy_tank{{0}},
+    steps(0),
+    entropy_rate(0),
+    entropy_cursor(0),
+    squeeze_mode(SQUEEZE_PARITY),
+    range_mode(RANGE_REJECTION),
+    absorb_position(0),
+    counter_mode(false),
+    counter(0),
+    counter_key{{0}} {}
+
+static bool _sparkle512_valid_setup(const unsigned int steps,
+                                    const unsigned int rate,
+                                    const unsigned int squeeze_mode)
+{
+    return (steps >= 1)
+        && (steps <= SPARKLE512_MAX_STEPS)
+        && (rate > 0)
+        && (rate % 32 == 0)
+        && (rate <= 32 * 2 * N_BRANCHES)
+        && ((squeeze_mode == SQUEEZE_PARITY) || (squeeze_mode == SQUEEZE_COPY));
+}
 
+static bool _sparkle512_valid_range_mode(const unsigned int mode)
+{
+    return (mode == RANGE_REJECTION) || (mode == RANGE_MULTIPLY);
+}
+
+
+SPARKLE512_INLINE
 void Sparkle512core::setup(const unsigned int _steps, const unsigned int _output_rate)
 {
+    setup(_steps, _output_rate, SQUEEZE_PARITY);
+}
+
+SPARKLE512_INLINE
+void Sparkle512core::setup(const unsigned int _steps,
+                           const unsigned int _output_rate,
+                           const unsigned int _squeeze_mode)
+{
+    if (!_sparkle512_valid_setup(_steps, _output_rate, _squeeze_mode))
+        throw std::invalid_argument("invalid number of steps, output rate or squeeze mode");
     steps = _steps;
-    entropy_tank.assign(_output_rate, false);
+    squeeze_mode = _squeeze_mode;
+    entropy_rate = _output_rate;
+    entropy_tank.fill(0);
+    entropy_cursor = 0;
+}
+
+SPARKLE512_INLINE
+unsigned int Sparkle512core::output_rate() const
+{
+    return entropy_rate;
 }
 
+SPARKLE512_INLINE
 void Sparkle512core::_permute()
 {
-    unsigned int i, j;  // Step and branch counter
-    uint32_t rc, tmpx, tmpy, x0, y0;
-  
-    for(i = 0; i < steps; i ++) {
-        // Add round constant
-        state[1] ^= RCON[i % N_BRANCHES];
-        state[3] ^= i;
-        // ARXBOX layer
-        for(j = 0; j < 2*N_BRANCHES; j += 2) {
-            rc = RCON[j>>1];
-            state[j] += ROT(state[j+1], 31);
-            state[j+1] ^= ROT(state[j], 24);
-            state[j] ^= rc;
-            state[j] += ROT(state[j+1], 17);
-            state[j+1] ^= ROT(state[j], 17);
-            state[j] ^= rc;
-            state[j] += state[j+1];
-            state[j+1] ^= ROT(state[j], 31);
-            state[j] ^= rc;
-            state[j] += ROT(state[j+1], 24);
-            state[j+1] ^= ROT(state[j], 16);
-            state[j] ^= rc;
-        }
-        // Linear layer
-        tmpx = x0 = state[0];
-        tmpy = y0 = state[1];
-        for(j = 2; j < N_BRANCHES; j += 2) {
-            tmpx ^= state[j];
-            tmpy ^= state[j+1];
-        }
-        tmpx = ELL(tmpx);
-        tmpy = ELL(tmpy);
-        for (j = 2; j < N_BRANCHES; j += 2) {
-            state[j-2] = state[j+N_BRANCHES] ^ state[j] ^ tmpy;
-            state[j+N_BRANCHES] = state[j];
-            state[j-1] = state[j+N_BRANCHES+1] ^ state[j+1] ^ tmpx;
-            state[j+N_BRANCHES+1] = state[j+1];
-        }
-        state[N_BRANCHES-2] = state[N_BRANCHES] ^ x0 ^ tmpy;
-        state[N_BRANCHES] = x0;
-        state[N_BRANCHES-1] = state[N_BRANCHES+1] ^ y0 ^ tmpx;
-        state[N_BRANCHES+1] = y0;
+#ifdef SPARKLE512_COUNTERS
+    const uint64_t start = _sparkle512_cycles();
+#endif
+    sparkle512_permutation(state.data(), steps);
+    SPARKLE512_COUNT(this, permutations, 1);
+    SPARKLE512_COUNT(this, cycles, _sparkle512_cycles() - start);
+}
+
+SPARKLE512_INLINE
+uint32_t Sparkle512core::_squeeze_word(uint32_t word) const
+{
+    if (squeeze_mode == SQUEEZE_PARITY)
+    {
+        word ^= word >> 1;
+        word ^= word >> 2;
+        word ^= word >> 4;
+        word ^= word >> 8;
+        word ^= word >> 16;
     }
+    return word;
 }
 
+SPARKLE512_INLINE
 void Sparkle512core::_squeeze()
 {
     uint32_t tmp;
-    for (unsigned int i=0; i<entropy_tank.size(); i += 32)
+    for (unsigned int k=0; k<entropy_rate/32; k++)
     {
-        unsigned int k = i / 32; 
-        tmp = state[k]; 
-        for(unsigned int j=0; j<32; j++)
-            entropy_tank[i+j] = (__builtin_parityll(state[k] >> j));
+        tmp = _squeeze_word(state[k]);
+        if (k & 1)
+            entropy_tank[k >> 1] |= ((uint64_t)tmp) << 32;
+        else
+            entropy_tank[k >> 1] = tmp;
     }
     entropy_cursor = 0;
 }
 
-void Sparkle512core::absorb(const std::vector<uint8_t> byte_array)
+SPARKLE512_INLINE
+uint64_t Sparkle512core::_read_tank(const unsigned int position,
+                                    const unsigned int n) const
+{
+    const unsigned int
+        word = position >> 6,
+        offset = position & 63;
+    uint64_t result = entropy_tank[word] >> offset;
+    if (offset + n > 64)
+        result |= entropy_tank[word + 1] << (64 - offset);
+    if (n < 64)
+        result &= (((uint64_t)1) << n) - 1;
+    return result;
+}
+
+SPARKLE512_INLINE
+void Sparkle512core::_start_absorb(const uint8_t * byte_array, const size_t length)
 {
+    _leave_counter_mode();
     state[2*N_BRANCHES-1] ^= 1;
-    for(unsigned int i=0; i<byte_array.size(); i+=4)
+    for(unsigned int i=0; i<2*N_BRANCHES; i++)
+        state[i] ^= 0x30303030;
+    for(size_t i=0; i<length; i++)
+        state[i >> 2] ^= ((uint32_t)(byte_array[i] ^ 0x30)) << (8*(i & 3));
+    state[length >> 2] ^= ((uint32_t)('1' ^ '0')) << (8*(length & 3));
+}
+
+
+SPARKLE512_INLINE
+void Sparkle512core::absorb(const uint8_t * byte_array, const size_t length)
+{
+    if (length > 4*2*N_BRANCHES - 1)
+        throw std::invalid_argument("cannot absorb more than 63 bytes at once");
+    _start_absorb(byte_array, length);
+    _permute();
+    state[2*N_BRANCHES-1] ^= 2;
+    _permute();
+    _squeeze();
+}
+
+SPARKLE512_INLINE
+void Sparkle512core::absorb(const std::vector<uint8_t> & byte_array)
+{
+    absorb(byte_array.data(), byte_array.size());
+}
+
+SPARKLE512_INLINE
+void Sparkle512core::absorb_update(const uint8_t * bytes, const size_t length)
+{
+    const unsigned int block = entropy_rate / 8;
+    size_t i = 0;
+    _leave_counter_mode();
+    while (i < length)
     {
-        for(unsigned int j=0; j<4; j++)
-            state[i >> 2] ^= ((uint32_t)byte_array[i + j]) << (8*j) ;
+        if (((absorb_position & 3) == 0) && (i + 4 <= length))
+        {
+            state[absorb_position >> 2] ^=
+                ((uint32_t)bytes[i])
+                | (((uint32_t)bytes[i+1]) << 8)
+                | (((uint32_t)bytes[i+2]) << 16)
+                | (((uint32_t)bytes[i+3]) << 24);
+            absorb_position += 4;
+            i += 4;
+        }
+        else
+        {
+            state[absorb_position >> 2] ^= ((uint32_t)bytes[i]) << (8*(absorb_position & 3));
+            absorb_position ++;
+            i ++;
+        }
+        if (absorb_position == block)
+        {
+            _permute();
+            absorb_position = 0;
+        }
     }
+}
+
+SPARKLE512_INLINE
+void Sparkle512core::absorb_final()
+{
+    const unsigned int block = entropy_rate / 8;
+    _leave_counter_mode();
+    state[absorb_position >> 2] ^= ((uint32_t)'1') << (8*(absorb_position & 3));
+    for (unsigned int i=absorb_position+1; i<block; i++)
+        state[i >> 2] ^= ((uint32_t)'0') << (8*(i & 3));
+    absorb_position = 0;
+    state[2*N_BRANCHES-1] ^= 4;
     _permute();
     state[2*N_BRANCHES-1] ^= 2;
     _permute();
     _squeeze();
 }
 
-uint64_t Sparkle512core::get_n_bit_unsigned_integer(const unsigned int n)
+SPARKLE512_INLINE
+void Sparkle512core::absorb_file(const char * path)
 {
-    uint64_t result = 0;
-    for (unsigned int i=0; i<n; i ++)
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error(std::string("could not open ") + path);
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) < 0)
+    {
+        close(fd);
+        throw std::runtime_error(std::string("could not stat ") + path);
+    }
+    const size_t length = file_stat.st_size;
+    if (length > 0)
     {
-        if (entropy_cursor == entropy_tank.size())
+        void * content = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (content == MAP_FAILED)
         {
-            _permute();
-            _squeeze();
+            close(fd);
+            throw std::runtime_error(std::string("could not map ") + path);
+        }
+        madvise(content, length, MADV_SEQUENTIAL);
+        absorb_update((const uint8_t *)content, length);
+        munmap(content, length);
+    }
+    close(fd);
+}
+
+SPARKLE512_INLINE
+void Sparkle512core::_start_derive(const uint64_t index,
+                                   const uint32_t domain,
+                                   Sparkle512core * child) const
+{
+    *child = *this;
+    child->_leave_counter_mode();
+    child->absorb_position = 0;
+    child->state[0] ^= (uint32_t)index;
+    child->state[1] ^= (uint32_t)(index >> 32);
+    child->state[2*N_BRANCHES-1] ^= domain;
+}
+
+
+SPARKLE512_INLINE
+void Sparkle512core::_derive(const uint64_t index,
+                             const uint32_t domain,
+                             Sparkle512core * child) const
+{
+    _start_derive(index, domain, child);
+    child->_permute();
+    child->state[2*N_BRANCHES-1] ^= 2;
+    child->_permute();
+    child->_squeeze();
+}
+
+
+SPARKLE512_INLINE
+void Sparkle512core::_start_fork(const uint64_t index, Sparkle512core * child) const
+{
+    _start_derive(index, SPARKLE512_DOMAIN_FORK, child);
+}
+
+
+SPARKLE512_INLINE
+void Sparkle512core::fork(const uint64_t index, Sparkle512core * child) const
+{
+    _derive(index, SPARKLE512_DOMAIN_FORK, child);
+}
+
+SPARKLE512_INLINE
+void Sparkle512core::split(Sparkle512core * children, const size_t k) const
+{
+    std::vector<Sparkle512core*> pointers(k);
+    for (size_t i=0; i<k; i++)
+    {
+        _start_fork(i, children + i);
+        pointers[i] = children + i;
+    }
+    permute_many(pointers.data(), k);
+    for (size_t i=0; i<k; i++)
+        children[i].state[2*N_BRANCHES-1] ^= 2;
+    permute_many(pointers.data(), k);
+    for (size_t i=0; i<k; i++)
+        children[i]._squeeze();
+}
+
+SPARKLE512_INLINE
+void Sparkle512core::absorb_ids(Sparkle512core * children,
+                                const uint64_t * ids,
+                                const size_t k) const
+{
+    std::vector<Sparkle512core*> pointers(k);
+    for (size_t i=0; i<k; i++)
+    {
+        uint8_t digits[20];
+        unsigned int length = 0;
+        uint64_t id = ids[i];
+        do
+        {
+            digits[19 - length] = '0' + (id % 10);
+            id /= 10;
+            length ++;
+        } while (id > 0);
+        children[i] = *this;
+        children[i]._start_absorb(digits + 20 - length, length);
+        pointers[i] = children + i;
+    }
+    permute_many(pointers.data(), k);
+    for (size_t i=0; i<k; i++)
+        children[i].state[2*N_BRANCHES-1] ^= 2;
+    permute_many(pointers.data(), k);
+    for (size_t i=0; i<k; i++)
+        children[i]._squeeze();
+}
+
+SPARKLE512_INLINE
+void Sparkle512core::_load_counter_block(const uint64_t index)
+{
+    state = counter_key;
+    state[0] ^= (uint32_t)index;
+    state[1] ^= (uint32_t)(index >> 32);
+}
+
+
+SPARKLE512_INLINE
+void Sparkle512core::_next_block()
+{
+    if (counter_mode)
+        _load_counter_block(counter ++);
+    _permute();
+}
+
+
+SPARKLE512_INLINE
+void Sparkle512core::_leave_counter_mode()
+{
+    if (counter_mode)
+    {
+        state = counter_key;
+        counter_mode = false;
+    }
+}
+
+
+SPARKLE512_INLINE
+void Sparkle512core::start_counter_mode()
+{
+    counter_key = state;
+    counter_key[2*N_BRANCHES-1] ^= 16;
+    counter_mode = true;
+    seek(0);
+}
+
+
+SPARKLE512_INLINE
+void Sparkle512core::seek(const uint64_t block_index)
+{
+    counter = block_index;
+    _next_block();
+    _squeeze();
+}
+
+SPARKLE512_INLINE
+void Sparkle512core::fill_blocks(uint32_t * out,
+                                 const uint64_t first_block,
+                                 const size_t n_blocks) const
+{
+    if (!counter_mode)
+        throw std::logic_error("fill_blocks requires the counter mode");
+    const unsigned int
+        n_lanes = lanes(),
+        words = entropy_rate / 32;
+    const size_t n_groups = (n_blocks + n_lanes - 1) / n_lanes;
+    #pragma omp parallel
+    {
+        std::vector<Sparkle512core> group(n_lanes, *this);
+        std::vector<Sparkle512core*> pointers(n_lanes);
+        for (unsigned int l=0; l<n_lanes; l++)
+            pointers[l] = &group[l];
+        #pragma omp for schedule(static)
+        for (size_t g=0; g<n_groups; g++)
+        {
+            const size_t
+                start = g * n_lanes,
+                size = std::min<size_t>(n_lanes, n_blocks - start);
+            for (size_t l=0; l<size; l++)
+                group[l]._load_counter_block(first_block + start + l);
+            permute_many(pointers.data(), size);
+            for (size_t l=0; l<size; l++)
+                for (unsigned int k=0; k<words; k++)
+                    out[(start + l) * words + k] = group[l]._squeeze_word(group[l].state[k]);
         }
-        if (entropy_tank[entropy_cursor])
-            result |= (1 << i);
-        entropy_cursor ++;
     }
+}
+
+static void _sparkle512_put(std::vector<uint8_t> & blob,
+                            const uint64_t x,
+                            const unsigned int n_bytes)
+{
+    for (unsigned int i=0; i<n_bytes; i++)
+        blob.push_back((uint8_t)(x >> (8*i)));
+}
+
+static uint64_t _sparkle512_get(const uint8_t * blob,
+                                const size_t length,
+                                size_t & position,
+                                const unsigned int n_bytes)
+{
+    if (position + n_bytes > length)
+        throw std::invalid_argument("truncated Sparkle512core state");
+    uint64_t x = 0;
+    for (unsigned int i=0; i<n_bytes; i++)
+        x |= ((uint64_t)blob[position + i]) << (8*i);
+    position += n_bytes;
+    return x;
+}
+
+SPARKLE512_INLINE
+std::vector<uint8_t> Sparkle512core::save_state() const
+{
+    std::vector<uint8_t> blob;
+    const size_t tank_words = entropy_rate / 64 + 1;
+    _sparkle512_put(blob, SPARKLE512_STATE_MAGIC, 4);
+    _sparkle512_put(blob, SPARKLE512_STATE_VERSION, 4);
+    _sparkle512_put(blob, steps, 4);
+    _sparkle512_put(blob, entropy_rate, 4);
+    _sparkle512_put(blob, entropy_cursor, 4);
+    _sparkle512_put(blob, entropy_rate, 4);
+    _sparkle512_put(blob, 1, 4);
+    _sparkle512_put(blob, squeeze_mode, 4);
+    _sparkle512_put(blob, range_mode, 4);
+    _sparkle512_put(blob, absorb_position, 4);
+    for (unsigned int i=0; i<2*N_BRANCHES; i++)
+        _sparkle512_put(blob, state[i], 4);
+    _sparkle512_put(blob, counter_mode, 4);
+    _sparkle512_put(blob, counter, 8);
+    for (unsigned int i=0; i<2*N_BRANCHES; i++)
+        _sparkle512_put(blob, counter_key[i], 4);
+    for (size_t i=0; i<tank_words; i++)
+        _sparkle512_put(blob, entropy_tank[i], 8);
+    return blob;
+}
+
+SPARKLE512_INLINE
+void Sparkle512core::load_state(const uint8_t * blob, const size_t length)
+{
+    size_t position = 0;
+    if (_sparkle512_get(blob, length, position, 4) != SPARKLE512_STATE_MAGIC)
+        throw std::invalid_argument("not a Sparkle512core state");
+    const uint64_t version = _sparkle512_get(blob, length, position, 4);
+    if ((version == 0) || (version > SPARKLE512_STATE_VERSION))
+        throw std::invalid_argument("unsupported Sparkle512core state version");
+    Sparkle512core loaded;
+    loaded.steps = _sparkle512_get(blob, length, position, 4);
+    loaded.entropy_rate = _sparkle512_get(blob, length, position, 4);
+    loaded.entropy_cursor = _sparkle512_get(blob, length, position, 4);
+    const uint64_t
+        tank_size = _sparkle512_get(blob, length, position, 4),
+        tank_blocks = _sparkle512_get(blob, length, position, 4);
+    loaded.squeeze_mode = _sparkle512_get(blob, length, position, 4);
+    loaded.range_mode = _sparkle512_get(blob, length, position, 4);
+    loaded.absorb_position = _sparkle512_get(blob, length, position, 4);
+    const bool set_up = (loaded.steps != 0) || (loaded.entropy_rate != 0);
+    if ((set_up && !_sparkle512_valid_setup(loaded.steps,
+                                            loaded.entropy_rate,
+                                            loaded.squeeze_mode))
+        || !_sparkle512_valid_range_mode(loaded.range_mode)
+        || (tank_size != loaded.entropy_rate)
+        || (tank_blocks != 1)
+        || (loaded.entropy_cursor > loaded.entropy_rate)
+        || ((loaded.absorb_position > 0) && (8 * loaded.absorb_position >= loaded.entropy_rate)))
+        throw std::invalid_argument("inconsistent Sparkle512core state");
+    for (unsigned int i=0; i<2*N_BRANCHES; i++)
+        loaded.state[i] = _sparkle512_get(blob, length, position, 4);
+    if (version >= 2)
+    {
+        loaded.counter_mode = _sparkle512_get(blob, length, position, 4);
+        loaded.counter = _sparkle512_get(blob, length, position, 8);
+        for (unsigned int i=0; i<2*N_BRANCHES; i++)
+            loaded.counter_key[i] = _sparkle512_get(blob, length, position, 4);
+    }
+    const size_t tank_words = loaded.entropy_rate / 64 + 1;
+    if (length - position != 8 * tank_words)
+        throw std::invalid_argument("inconsistent Sparkle512core state");
+    for (size_t i=0; i<tank_words; i++)
+        loaded.entropy_tank[i] = _sparkle512_get(blob, length, position, 8);
+#ifdef SPARKLE512_COUNTERS
+    loaded.counters = counters;
+#endif
+    *this = loaded;
+}
+
+SPARKLE512_INLINE
+Sparkle512counters Sparkle512core::get_counters() const
+{
+#ifdef SPARKLE512_COUNTERS
+    return counters;
+#else
+    return Sparkle512counters{0, 0, 0, 0};
+#endif
+}
+
+SPARKLE512_INLINE
+void Sparkle512core::reset_counters()
+{
+#ifdef SPARKLE512_COUNTERS
+    counters = Sparkle512counters{0, 0, 0, 0};
+#endif
+}
+
+SPARKLE512_INLINE
+bool Sparkle512core::counters_enabled()
+{
+#ifdef SPARKLE512_COUNTERS
+    return true;
+#else
+    return false;
+#endif
+}
+
+SPARKLE512_INLINE
+uint64_t Sparkle512core::get_n_bit_unsigned_integer(const unsigned int n)
+{
+    uint64_t result = 0;
+    unsigned int filled = 0;
+    SPARKLE512_COUNT(this, bits, n);
+    while (n - filled > entropy_rate - entropy_cursor)
+    {
+        result |= _read_tank(entropy_cursor, entropy_rate - entropy_cursor) << filled;
+        filled += entropy_rate - entropy_cursor;
+        _next_block();
+        _squeeze();
+    }
+    result |= _read_tank(entropy_cursor, n - filled) << filled;
+    entropy_cursor += n - filled;
     return result;
 }
 
+SPARKLE512_INLINE
 uint64_t Sparkle512core::get_unsigned_integer_in_range(
     const uint64_t lower_bound,
     const uint64_t upper_bound)
@@ -111,9 +546,675 @@ uint64_t Sparkle512core::get_unsigned_integer_in_range(
         bit_length = 64 - __builtin_clzll(upper_bound - lower_bound),
         range = upper_bound - lower_bound,
         output ;
+    if (range_mode == RANGE_MULTIPLY)
+        return lower_bound + _get_multiply_shift(range);
     do
     {
         output = get_n_bit_unsigned_integer(bit_length);
+        SPARKLE512_COUNT(this, rejections, output >= range);
     } while (output >= range) ;
     return lower_bound + output;    
 }
+
+SPARKLE512_INLINE
+void Sparkle512core::set_range_mode(const unsigned int mode)
+{
+    if (!_sparkle512_valid_range_mode(mode))
+        throw std::invalid_argument("unknown range mode");
+    range_mode = mode;
+}
+
+SPARKLE512_INLINE
+uint64_t Sparkle512core::_get_multiply_shift(const uint64_t range)
+{
+    const unsigned int
+        bit_length = 64 - __builtin_clzll(range),
+        n = (bit_length + RANGE_MULTIPLY_EXTRA_BITS < 64) ?
+            bit_length + RANGE_MULTIPLY_EXTRA_BITS : 64;
+    const uint64_t mask = (n == 64) ? ~((uint64_t)0) : (((uint64_t)1) << n) - 1;
+    unsigned __int128 product = ((unsigned __int128)get_n_bit_unsigned_integer(n)) * range;
+    uint64_t low = ((uint64_t)product) & mask;
+    if (low < range)
+    {
+        // (2^n - range) mod range, which is equal to 2^n mod range
+        const uint64_t threshold = (mask - range + 1) % range;
+        while (low < threshold)
+        {
+            SPARKLE512_COUNT(this, rejections, 1);
+            product = ((unsigned __int128)get_n_bit_unsigned_integer(n)) * range;
+            low = ((uint64_t)product) & mask;
+        }
+    }
+    return (uint64_t)(product >> n);
+}
+
+SPARKLE512_INLINE
+void Sparkle512core::fill(uint64_t * out,
+                          const size_t count,
+                          const unsigned int n)
+{
+    fill_words(out, count, n);
+}
+
+SPARKLE512_INLINE
+void Sparkle512core::fill_in_range(uint64_t * out,
+                                   const size_t count,
+                                   const uint64_t lower_bound,
+                                   const uint64_t upper_bound)
+{
+    uint64_t
+        bit_length = 64 - __builtin_clzll(upper_bound - lower_bound),
+        range = upper_bound - lower_bound,
+        output ;
+    if (range_mode == RANGE_MULTIPLY)
+    {
+        for (size_t i=0; i<count; i++)
+            out[i] = lower_bound + _get_multiply_shift(range);
+        return;
+    }
+    for (size_t i=0; i<count; i++)
+    {
+        do
+        {
+            output = get_n_bit_unsigned_integer(bit_length);
+            SPARKLE512_COUNT(this, rejections, output >= range);
+        } while (output >= range) ;
+        out[i] = lower_bound + output;
+    }
+}
+
+template<unsigned int LANES>
+void Sparkle512core::_permute_lanes(Sparkle512core * const * cores)
+{
+#ifdef SPARKLE512_COUNTERS
+    const uint64_t start = _sparkle512_cycles();
+#endif
+    typename Sparkle512lanes<LANES>::word_t lanes_state[2*N_BRANCHES];
+    for (unsigned int i=0; i<2*N_BRANCHES; i++)
+        for (unsigned int l=0; l<LANES; l++)
+            lanes_state[i][l] = cores[l]->state[i];
+    sparkle512_permutation(lanes_state, cores[0]->steps);
+    for (unsigned int i=0; i<2*N_BRANCHES; i++)
+        for (unsigned int l=0; l<LANES; l++)
+            cores[l]->state[i] = lanes_state[i][l];
+#ifdef SPARKLE512_COUNTERS
+    const uint64_t elapsed = _sparkle512_cycles() - start;
+    for (unsigned int l=0; l<LANES; l++)
+    {
+        SPARKLE512_COUNT(cores[l], permutations, 1);
+        SPARKLE512_COUNT(cores[l], cycles, elapsed / LANES);
+    }
+#endif
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx512f")))
+static void _sparkle512_permute_avx512(Sparkle512core * const * cores)
+{
+    Sparkle512core::_permute_lanes<16>(cores);
+}
+
+__attribute__((target("avx2")))
+static void _sparkle512_permute_avx2(Sparkle512core * const * cores)
+{
+    Sparkle512core::_permute_lanes<8>(cores);
+}
+#endif
+
+SPARKLE512_INLINE
+unsigned int Sparkle512core::lanes()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    if (__builtin_cpu_supports("avx512f"))
+        return 16;
+    else if (__builtin_cpu_supports("avx2"))
+        return 8;
+#endif
+    return 4;
+}
+
+SPARKLE512_INLINE
+void Sparkle512core::permute_many(Sparkle512core * const * cores,
+                                  const size_t count)
+{
+    const unsigned int n_lanes = lanes();
+    size_t i = 0;
+    for (; i + n_lanes <= count; i += n_lanes)
+    {
+        bool same_steps = true;
+        for (unsigned int l=1; l<n_lanes; l++)
+            same_steps = same_steps && (cores[i+l]->steps == cores[i]->steps);
+        if (!same_steps)
+        {
+            for (unsigned int l=0; l<n_lanes; l++)
+                cores[i+l]->_permute();
+        }
+#if defined(__x86_64__) || defined(__i386__)
+        else if (n_lanes == 16)
+            _sparkle512_permute_avx512(cores + i);
+        else if (n_lanes == 8)
+            _sparkle512_permute_avx2(cores + i);
+#endif
+        else
+            _permute_lanes<4>(cores + i);
+    }
+    for (; i < count; i++)
+        cores[i]->_permute();
+}
+
+SPARKLE512_INLINE
+void Sparkle512core::fill_many(Sparkle512core * const * cores,
+                               const size_t n_cores,
+                               uint64_t * out,
+                               const size_t count,
+                               const unsigned int n)
+{
+    std::vector<Sparkle512core*> dry(n_cores);
+    std::vector<unsigned int> filled(n_cores);
+    for (size_t i=0; i<count; i++)
+    {
+        for (size_t k=0; k<n_cores; k++)
+        {
+            out[k*count + i] = 0;
+            filled[k] = 0;
+        }
+        size_t n_dry;
+        do
+        {
+            n_dry = 0;
+            for (size_t k=0; k<n_cores; k++)
+            {
+                Sparkle512core * c = cores[k];
+                if (n - filled[k] > c->entropy_rate - c->entropy_cursor)
+                {
+                    out[k*count + i] |= c->_read_tank(
+                        c->entropy_cursor,
+                        c->entropy_rate - c->entropy_cursor) << filled[k];
+                    filled[k] += c->entropy_rate - c->entropy_cursor;
+                    c->entropy_cursor = c->entropy_rate;
+                    dry[n_dry] = c;
+                    n_dry ++;
+                }
+            }
+            for (size_t k=0; k<n_dry; k++)
+                if (dry[k]->counter_mode)
+                    dry[k]->_load_counter_block(dry[k]->counter ++);
+            permute_many(dry.data(), n_dry);
+            for (size_t k=0; k<n_dry; k++)
+                dry[k]->_squeeze();
+        } while (n_dry > 0);
+        for (size_t k=0; k<n_cores; k++)
+        {
+            Sparkle512core * c = cores[k];
+            out[k*count + i] |= c->_read_tank(c->entropy_cursor, n - filled[k]) << filled[k];
+            c->entropy_cursor += n - filled[k];
+            SPARKLE512_COUNT(c, bits, n);
+        }
+    }
+}
+
+SPARKLE512_INLINE
+void Sparkle512core::random_permutation(uint64_t * out,
+                                        const size_t n,
+                                        const bool batched)
+{
+    for (size_t i=0; i<n; i++)
+        out[i] = i;
+    if (batched)
+        shuffle_batched(out, n);
+    else
+        shuffle(out, n);
+}
+
+SPARKLE512_INLINE
+void Sparkle512core::random_subset(uint64_t * out, const uint64_t n, const size_t k)
+{
+    std::unordered_set<uint64_t> subset;
+    subset.reserve(2 * k);
+    for (uint64_t j=n-k, i=0; i<k; j++, i++)
+    {
+        const uint64_t t = get_unsigned_integer_in_range(0, j + 1);
+        out[i] = subset.insert(t).second ? t : j;
+        if (out[i] == j)
+            subset.insert(j);
+    }
+}
+
+SPARKLE512_INLINE
+void Sparkle512core::random_sorted_subset(uint64_t * out, const uint64_t n, const size_t k)
+{
+    if (n > SPARKLE512_EXACT_DOUBLE)
+    {
+        random_subset(out, n, k);
+        std::sort(out, out + k);
+        return;
+    }
+    uint64_t current = 0;   // the next element that can be picked
+    double
+        remaining = n,      // number of elements that can still be picked
+        to_pick = k;
+    size_t i = 0;
+    // Method D
+    double v_prime = exp(log(get_uniform_double()) / to_pick);
+    double threshold = 13 * to_pick;
+    uint64_t skip;
+    while ((to_pick > 1) && (threshold < remaining))
+    {
+        const double
+            n_min_1_inv = 1 / (to_pick - 1),
+            qu1 = remaining - to_pick + 1;
+        while (true)
+        {
+            // D2: S is the integer part of X, following a continuous
+            // approximation of its distribution
+            double x;
+            while (true)
+            {
+                x = remaining * (1 - v_prime);
+                skip = (uint64_t)x;
+                if (skip < qu1)
+                    break;
+                v_prime = exp(log(get_uniform_double()) / to_pick);
+            }
+            const double
+                u = 1 - get_uniform_double(),
+                y1 = exp(log(u * remaining / qu1) * n_min_1_inv);
+            // D3: quick acceptance
+            v_prime = y1 * (1 - x / remaining) * (qu1 / (qu1 - skip));
+            if (v_prime <= 1)
+                break;
+            // D4: exact acceptance
+            double y2 = 1, top = remaining - 1, bottom, limit;
+            if (to_pick - 1 > skip)
+            {
+                bottom = remaining - to_pick;
+                limit = remaining - skip;
+            }
+            else
+            {
+                bottom = remaining - skip - 1;
+                limit = qu1;
+            }
+            for (double t=remaining-1; t>=limit; t--)
+            {
+                y2 = (y2 * top) / bottom;
+                top --;
+                bottom --;
+            }
+            if (remaining / (remaining - x) >= y1 * exp(log(y2) * n_min_1_inv))
+            {
+                v_prime = exp(log(get_uniform_double()) * n_min_1_inv);
+                break;
+            }
+            v_prime = exp(log(get_uniform_double()) / to_pick);
+        }
+        // D5: skipping S elements and picking the next one
+        current += skip;
+        out[i++] = current++;
+        remaining -= skip + 1;
+        to_pick --;
+        threshold -= 13;
+    }
+    if (to_pick > 1)
+    {
+        // Method A
+        double top = remaining - to_pick;
+        while (to_pick > 1)
+        {
+            const double v = get_uniform_double();
+            double quot = top / remaining;
+            skip = 0;
+            while (quot > v)
+            {
+                skip ++;
+                top --;
+                remaining --;
+                quot = (quot * top) / remaining;
+            }
+            current += skip;
+            out[i++] = current++;
+            remaining --;
+            to_pick --;
+        }
+        v_prime = get_uniform_double();
+    }
+    if (to_pick == 1)
+    {
+        // the last element is picked uniformly among the remaining ones
+        skip = (uint64_t)(remaining * v_prime);
+        out[i] = current + std::min<uint64_t>(skip, remaining - 1);
+    }
+}
+
+SPARKLE512_INLINE
+void Sparkle512core::random_bit_matrix(uint64_t * out,
+                                       const size_t rows,
+                                       const size_t cols)
+{
+    const size_t
+        row_words = (cols + 63) / 64,
+        full_words = cols / 64;
+    for (size_t r=0; r<rows; r++)
+    {
+        uint64_t * row = out + r * row_words;
+        for (size_t w=0; w<full_words; w++)
+            row[w] = get_n_bit_unsigned_integer(64);
+        if (full_words < row_words)
+            row[full_words] = get_n_bit_unsigned_integer(cols % 64);
+    }
+}
+
+SPARKLE512_INLINE
+void Sparkle512core::random_invertible_bit_matrix(uint64_t * out, const size_t n)
+{
+    const size_t row_words = (n + 63) / 64;
+    std::vector<uint64_t> basis(n * row_words);
+    std::vector<size_t> pivots(n);
+    for (size_t r=0; r<n; r++)
+    {
+        uint64_t * row = out + r * row_words,
+            * reduced = basis.data() + r * row_words;
+        bool independent = false;
+        while (!independent)
+        {
+            random_bit_matrix(row, 1, n);
+            std::copy(row, row + row_words, reduced);
+            for (size_t k=0; k<r; k++)
+                if ((reduced[pivots[k] / 64] >> (pivots[k] % 64)) & 1)
+                {
+                    const uint64_t * basis_vector = basis.data() + k * row_words;
+                    for (size_t w=0; w<row_words; w++)
+                        reduced[w] ^= basis_vector[w];
+                }
+            for (size_t w=0; (w<row_words) && !independent; w++)
+                if (reduced[w] != 0)
+                {
+                    pivots[r] = 64 * w + __builtin_ctzll(reduced[w]);
+                    independent = true;
+                }
+        }
+    }
+}
+
+SPARKLE512_INLINE
+double Sparkle512core::get_uniform_double()
+{
+    return get_n_bit_unsigned_integer(53) * 0x1.0p-53;
+}
+
+SPARKLE512_INLINE
+void Sparkle512core::fill_uniform(double * out, const size_t count)
+{
+    for (size_t i=0; i<count; i++)
+        out[i] = get_uniform_double();
+}
+
+SPARKLE512_INLINE
+Sparkle512ziggurat::Sparkle512ziggurat()
+{
+    double x;
+    // normal distribution, f(x) = exp(-x^2/2)
+    normal_x[0] = ZIGGURAT_NORMAL_V / exp(-0.5 * ZIGGURAT_NORMAL_R * ZIGGURAT_NORMAL_R);
+    normal_x[1] = ZIGGURAT_NORMAL_R;
+    for (unsigned int i=2; i<ZIGGURAT_NORMAL_LAYERS; i++)
+    {
+        x = normal_x[i-1];
+        normal_x[i] = sqrt(-2 * log(ZIGGURAT_NORMAL_V / x + exp(-0.5 * x * x)));
+    }
+    normal_x[ZIGGURAT_NORMAL_LAYERS] = 0;
+    for (unsigned int i=0; i<ZIGGURAT_NORMAL_LAYERS; i++)
+        normal_ratio[i] = normal_x[i+1] / normal_x[i];
+    // exponential distribution, f(x) = exp(-x)
+    exponential_x[0] = ZIGGURAT_EXPONENTIAL_V / exp(-ZIGGURAT_EXPONENTIAL_R);
+    exponential_x[1] = ZIGGURAT_EXPONENTIAL_R;
+    for (unsigned int i=2; i<ZIGGURAT_EXPONENTIAL_LAYERS; i++)
+    {
+        x = exponential_x[i-1];
+        exponential_x[i] = -log(ZIGGURAT_EXPONENTIAL_V / x + exp(-x));
+    }
+    exponential_x[ZIGGURAT_EXPONENTIAL_LAYERS] = 0;
+    for (unsigned int i=0; i<ZIGGURAT_EXPONENTIAL_LAYERS; i++)
+        exponential_ratio[i] = exponential_x[i+1] / exponential_x[i];
+}
+
+static const Sparkle512ziggurat ZIGGURAT;
+
+SPARKLE512_INLINE
+double Sparkle512core::get_normal()
+{
+    while (true)
+    {
+        const uint64_t word = get_n_bit_unsigned_integer(64);
+        const unsigned int i = word & (ZIGGURAT_NORMAL_LAYERS - 1);
+        const double u = 2 * ((word >> 11) * 0x1.0p-53) - 1;
+        if (fabs(u) < ZIGGURAT.normal_ratio[i])
+            return u * ZIGGURAT.normal_x[i];
+        if (i == 0)
+        {
+            double a, b;
+            do
+            {
+                a = -log(1 - get_uniform_double()) / ZIGGURAT_NORMAL_R;
+                b = -log(1 - get_uniform_double());
+            } while (2 * b < a * a);
+            return (u < 0) ? -(ZIGGURAT_NORMAL_R + a) : (ZIGGURAT_NORMAL_R + a);
+        }
+        const double
+            x = u * ZIGGURAT.normal_x[i],
+            f0 = exp(-0.5 * (ZIGGURAT.normal_x[i] * ZIGGURAT.normal_x[i] - x * x)),
+            f1 = exp(-0.5 * (ZIGGURAT.normal_x[i+1] * ZIGGURAT.normal_x[i+1] - x * x));
+        if (f1 + get_uniform_double() * (f0 - f1) < 1)
+            return x;
+    }
+}
+
+SPARKLE512_INLINE
+double Sparkle512core::get_exponential()
+{
+    while (true)
+    {
+        const uint64_t word = get_n_bit_unsigned_integer(64);
+        const unsigned int i = word & (ZIGGURAT_EXPONENTIAL_LAYERS - 1);
+        const double u = (word >> 11) * 0x1.0p-53;
+        if (u < ZIGGURAT.exponential_ratio[i])
+            return u * ZIGGURAT.exponential_x[i];
+        if (i == 0)
+            return ZIGGURAT_EXPONENTIAL_R - log(1 - get_uniform_double());
+        const double
+            x = u * ZIGGURAT.exponential_x[i],
+            f0 = exp(-ZIGGURAT.exponential_x[i]),
+            f1 = exp(-ZIGGURAT.exponential_x[i+1]);
+        if (f1 + get_uniform_double() * (f0 - f1) < exp(-x))
+            return x;
+    }
+}
+
+SPARKLE512_INLINE
+void Sparkle512core::fill_normal(double * out,
+                                 const size_t count,
+                                 const double mean,
+                                 const double stddev)
+{
+    for (size_t i=0; i<count; i++)
+        out[i] = mean + stddev * get_normal();
+}
+
+SPARKLE512_INLINE
+void Sparkle512core::fill_exponential(double * out,
+                                      const size_t count,
+                                      const double rate)
+{
+    for (size_t i=0; i<count; i++)
+        out[i] = get_exponential() / rate;
+}
+
+SPARKLE512_INLINE
+bool Sparkle512core::get_bernoulli(const double p)
+{
+    return get_uniform_double() < p;
+}
+
+static double _sparkle512_binomial_fc(const double k)
+{
+    static const double TABLE[10] = {
+        0.08106146679532733, 0.04134069595540946, 0.027677925684997717,
+        0.020790672103765395, 0.016644691189820815, 0.013876128823072875,
+        0.011896709945893313, 0.010411265261971892, 0.009255462182707674,
+        0.008330563433357696
+    };
+    if (k < 10)
+        return TABLE[(unsigned int)k];
+    const double r = 1 / (k + 1), r2 = r * r;
+    return (1.0/12 - (1.0/360 - r2/1260) * r2) * r;
+}
+
+SPARKLE512_INLINE
+uint64_t Sparkle512core::_get_binomial_btrs(const uint64_t trials, const double p)
+{
+    const double
+        n = (double)trials,
+        q = 1 - p,
+        spq = sqrt(n * p * q),
+        b = 1.15 + 2.53 * spq,
+        a = -0.0873 + 0.0248 * b + 0.01 * p,
+        c = n * p + 0.5,
+        v_r = 0.92 - 4.2 / b,
+        alpha = (2.83 + 5.1 / b) * spq,
+        r = p / q,
+        m = floor((n + 1) * p);
+    while (true)
+    {
+        const double
+            u = get_uniform_double() - 0.5,
+            us = 0.5 - fabs(u),
+            k = floor((2 * a / us + b) * u + c);
+        double v = get_uniform_double();
+        if ((k < 0) || (k > n))
+            continue;
+        if ((us >= 0.07) && (v <= v_r))
+            return (uint64_t)k;
+        v = log(v * alpha / (a / (us * us) + b));
+        const double bound =
+            (m + 0.5) * log((m + 1) / (r * (n - m + 1)))
+            + (n + 1) * log((n - m + 1) / (n - k + 1))
+            + (k + 0.5) * log(r * (n - k + 1) / (k + 1))
+            + _sparkle512_binomial_fc(m) + _sparkle512_binomial_fc(n - m)
+            - _sparkle512_binomial_fc(k) - _sparkle512_binomial_fc(n - k);
+        if (v <= bound)
+            return (uint64_t)k;
+    }
+}
+
+SPARKLE512_INLINE
+uint64_t Sparkle512core::get_binomial(const uint64_t trials, const double p)
+{
+    if (p > 0.5)
+        return trials - get_binomial(trials, 1 - p);
+    if (!(p > 0))
+        return 0;
+    if (trials * p >= BINOMIAL_BTRS_THRESHOLD)
+        return _get_binomial_btrs(trials, p);
+    const double log_q = log1p(-p);
+    uint64_t successes = 0;
+    double position = 0;
+    while (true)
+    {
+        position += floor(log(1 - get_uniform_double()) / log_q) + 1;
+        if (position > trials)
+            return successes;
+        successes ++;
+    }
+}
+
+SPARKLE512_INLINE
+void Sparkle512core::fill_bernoulli(uint8_t * out, const size_t count, const double p)
+{
+    for (size_t i=0; i<count; i++)
+        out[i] = get_bernoulli(p);
+}
+
+SPARKLE512_INLINE
+void Sparkle512core::fill_binomial(uint64_t * out,
+                                   const size_t count,
+                                   const uint64_t trials,
+                                   const double p)
+{
+    for (size_t i=0; i<count; i++)
+        out[i] = get_binomial(trials, p);
+}
+
+SPARKLE512_INLINE
+Sparkle512pool::Sparkle512pool():
+    chunks_root(),
+    threads(1),
+    next_chunk(0) {}
+
+
+SPARKLE512_INLINE
+void Sparkle512pool::setup(const Sparkle512core & parent, const unsigned int n_threads)
+{
+    parent._derive(0, SPARKLE512_DOMAIN_POOL, &chunks_root);
+    threads = (n_threads > 0) ? n_threads : 1;
+    next_chunk = 0;
+}
+
+
+SPARKLE512_INLINE
+unsigned int Sparkle512pool::n_threads() const
+{
+    return threads;
+}
+
+#ifdef _OPENMP
+#include<omp.h>
+#endif
+
+SPARKLE512_INLINE
+unsigned int Sparkle512pool::max_threads()
+{
+#ifdef _OPENMP
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
+}
+
+
+SPARKLE512_INLINE
+void Sparkle512pool::fill(uint64_t * out,
+                          const size_t count,
+                          const unsigned int n)
+{
+    const size_t n_chunks = (count + SPARKLE512_POOL_CHUNK - 1) / SPARKLE512_POOL_CHUNK;
+    #pragma omp parallel for schedule(static) num_threads(n_threads())
+    for (size_t c=0; c<n_chunks; c++)
+    {
+        Sparkle512core chunk;
+        const size_t start = c * SPARKLE512_POOL_CHUNK;
+        chunks_root.fork(next_chunk + c, &chunk);
+        chunk.fill(out + start, std::min<size_t>(SPARKLE512_POOL_CHUNK, count - start), n);
+    }
+    next_chunk += n_chunks;
+}
+
+
+SPARKLE512_INLINE
+void Sparkle512pool::fill_in_range(uint64_t * out,
+                                   const size_t count,
+                                   const uint64_t lower_bound,
+                                   const uint64_t upper_bound)
+{
+    const size_t n_chunks = (count + SPARKLE512_POOL_CHUNK - 1) / SPARKLE512_POOL_CHUNK;
+    #pragma omp parallel for schedule(static) num_threads(n_threads())
+    for (size_t c=0; c<n_chunks; c++)
+    {
+        Sparkle512core chunk;
+        const size_t start = c * SPARKLE512_POOL_CHUNK;
+        chunks_root.fork(next_chunk + c, &chunk);
+        chunk.fill_in_range(out + start,
+                            std::min<size_t>(SPARKLE512_POOL_CHUNK, count - start),
+                            lower_bound,
+                            upper_bound);
+    }
+    next_chunk += n_chunks;
+}
@@ -1,6 +1,10 @@
+#pragma once
 #include<vector>
 #include<cstdint>
+#include<cstddef>
 #include<array>
+#include<utility>
+#include<algorithm>
 
 #define ROT(x, n) (((x) >> (n)) | ((x) << (32-(n))))
 #define ELL(x) (ROT(((x) ^ ((x) << 16)), 16))
@@ -12,20 +16,386 @@ static const uint32_t RCON[N_BRANCHES] = {
         0xBB1185EB, 0x4F7C7B57, 0xCFBFA1C8, 0xC2B3293D
         };
 
+#define SPARKLE512_TANK_WORDS (N_BRANCHES + 1)
+
+struct Sparkle512counters
+{
+    uint64_t permutations;
+    uint64_t bits;
+    uint64_t rejections;
+    uint64_t cycles;
+};
+
+#ifdef SPARKLE512_COUNTERS
+#define SPARKLE512_COUNT(core, counter, x) ((core)->counters.counter += (x))
+#else
+#define SPARKLE512_COUNT(core, counter, x)
+#endif
+
+static inline uint64_t _sparkle512_cycles()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    return 0;
+#endif
+}
+
 class Sparkle512core {
 private:
+    alignas(64) std::array<uint32_t, 2*N_BRANCHES> state;
+    alignas(64) std::array<uint64_t, SPARKLE512_TANK_WORDS> entropy_tank;
     unsigned int steps;
-    std::array<uint32_t, 2*N_BRANCHES> state;
-    std::vector<bool> entropy_tank;
+    unsigned int entropy_rate;
     unsigned int entropy_cursor;
+    unsigned int squeeze_mode;
+    unsigned int range_mode;
+    unsigned int absorb_position;
+    bool counter_mode;
+    uint64_t counter;
+    std::array<uint32_t, 2*N_BRANCHES> counter_key;
+    #ifdef SPARKLE512_COUNTERS
+    Sparkle512counters counters{0, 0, 0, 0};
+    #endif
     public:
     Sparkle512core();
     void setup(const unsigned int _steps, const unsigned int _output_rate);
-    void absorb(const std::vector<uint8_t> byte_array);
+    void setup(const unsigned int _steps,
+               const unsigned int _output_rate,
+               const unsigned int _squeeze_mode);
+    void set_range_mode(const unsigned int mode);
+    unsigned int output_rate() const;
+    void absorb(const uint8_t * byte_array, const size_t length);
+    void absorb(const std::vector<uint8_t> & byte_array);
+    void absorb_update(const uint8_t * bytes, const size_t length);
+    void absorb_file(const char * path);
+    void absorb_final();
+    void fork(const uint64_t index, Sparkle512core * child) const;
+    void split(Sparkle512core * children, const size_t k) const;
+    void absorb_ids(Sparkle512core * children,
+                    const uint64_t * ids,
+                    const size_t k) const;
+    void start_counter_mode();
+    void seek(const uint64_t block_index);
+    void fill_blocks(uint32_t * out, const uint64_t first_block, const size_t n_blocks) const;
+    std::vector<uint8_t> save_state() const;
+    void load_state(const uint8_t * blob, const size_t length);
+    Sparkle512counters get_counters() const;
+    void reset_counters();
+    static bool counters_enabled();
     uint64_t get_n_bit_unsigned_integer(const unsigned int n);
     uint64_t get_unsigned_integer_in_range(const uint64_t lower_bound,
                                            const uint64_t upper_bound);
+    void fill(uint64_t * out, const size_t count, const unsigned int n);
+    template<typename T>
+    void fill_words(T * out, const size_t count, const unsigned int n);
+    void fill_in_range(uint64_t * out,
+                       const size_t count,
+                       const uint64_t lower_bound,
+                       const uint64_t upper_bound);
+    static void fill_many(Sparkle512core * const * cores,
+                          const size_t n_cores,
+                          uint64_t * out,
+                          const size_t count,
+                          const unsigned int n);
+    static void permute_many(Sparkle512core * const * cores, const size_t count);
+    static unsigned int lanes();
+    template<typename T>
+    void shuffle(T * data, const size_t n);
+    template<typename T>
+    void shuffle_batched(T * data, const size_t n);
+    void random_permutation(uint64_t * out, const size_t n, const bool batched);
+    void random_subset(uint64_t * out, const uint64_t n, const size_t k);
+    void random_sorted_subset(uint64_t * out, const uint64_t n, const size_t k);
+    template<typename T>
+    void random_functions(T * out,
+                          const size_t n_tables,
+                          const unsigned int in_bits,
+                          const unsigned int out_bits);
+    template<typename T>
+    void random_sboxes(T * out, const size_t n_tables, const unsigned int n_bits);
+    typedef uint64_t result_type;
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return ~((result_type)0); }
+    result_type operator()() { return get_n_bit_unsigned_integer(64); }
+    void random_bit_matrix(uint64_t * out, const size_t rows, const size_t cols);
+    void random_invertible_bit_matrix(uint64_t * out, const size_t n);
+    double get_uniform_double();
+    double get_normal();
+    double get_exponential();
+    bool get_bernoulli(const double p);
+    uint64_t get_binomial(const uint64_t trials, const double p);
+    void fill_uniform(double * out, const size_t count);
+    void fill_normal(double * out,
+                     const size_t count,
+                     const double mean,
+                     const double stddev);
+    void fill_exponential(double * out, const size_t count, const double rate);
+    void fill_bernoulli(uint8_t * out, const size_t count, const double p);
+    void fill_binomial(uint64_t * out,
+                       const size_t count,
+                       const uint64_t trials,
+                       const double p);
     
     void _squeeze();
     void _permute();
+    void _next_block();
+    void _load_counter_block(const uint64_t index);
+    void _leave_counter_mode();
+    uint32_t _squeeze_word(uint32_t word) const;
+    uint64_t _get_binomial_btrs(const uint64_t trials, const double p);
+    uint64_t _read_tank(const unsigned int position, const unsigned int n) const;
+    uint64_t _get_multiply_shift(const uint64_t range);
+    void _start_fork(const uint64_t index, Sparkle512core * child) const;
+    void _start_derive(const uint64_t index,
+                       const uint32_t domain,
+                       Sparkle512core * child) const;
+    void _derive(const uint64_t index,
+                 const uint32_t domain,
+                 Sparkle512core * child) const;
+    void _start_absorb(const uint8_t * byte_array, const size_t length);
+    template<unsigned int LANES>
+    __attribute__((always_inline))
+    static inline void _permute_lanes(Sparkle512core * const * cores);
 };
+
+#include<type_traits>
+static_assert(std::is_trivially_copyable<Sparkle512core>::value,
+              "Sparkle512core must be trivially copyable");
+static_assert(alignof(Sparkle512core) == 64,
+              "Sparkle512core must be aligned on a cache line");
+
+template<typename word_t>
+__attribute__((always_inline))
+inline void sparkle512_step(word_t * state, const unsigned int i)
+{
+    unsigned int j;  // Branch counter
+    uint32_t rc;
+    word_t tmpx, tmpy, x0, y0;
+
+    // Add round constant
+    state[1] ^= RCON[i % N_BRANCHES];
+    state[3] ^= i;
+    // ARXBOX layer
+    for(j = 0; j < 2*N_BRANCHES; j += 2) {
+        rc = RCON[j>>1];
+        state[j] += ROT(state[j+1], 31);
+        state[j+1] ^= ROT(state[j], 24);
+        state[j] ^= rc;
+        state[j] += ROT(state[j+1], 17);
+        state[j+1] ^= ROT(state[j], 17);
+        state[j] ^= rc;
+        state[j] += state[j+1];
+        state[j+1] ^= ROT(state[j], 31);
+        state[j] ^= rc;
+        state[j] += ROT(state[j+1], 24);
+        state[j+1] ^= ROT(state[j], 16);
+        state[j] ^= rc;
+    }
+    // Linear layer
+    tmpx = x0 = state[0];
+    tmpy = y0 = state[1];
+    for(j = 2; j < N_BRANCHES; j += 2) {
+        tmpx ^= state[j];
+        tmpy ^= state[j+1];
+    }
+    tmpx = ELL(tmpx);
+    tmpy = ELL(tmpy);
+    for (j = 2; j < N_BRANCHES; j += 2) {
+        state[j-2] = state[j+N_BRANCHES] ^ state[j] ^ tmpy;
+        state[j+N_BRANCHES] = state[j];
+        state[j-1] = state[j+N_BRANCHES+1] ^ state[j+1] ^ tmpx;
+        state[j+N_BRANCHES+1] = state[j+1];
+    }
+    state[N_BRANCHES-2] = state[N_BRANCHES] ^ x0 ^ tmpy;
+    state[N_BRANCHES] = x0;
+    state[N_BRANCHES-1] = state[N_BRANCHES+1] ^ y0 ^ tmpx;
+    state[N_BRANCHES+1] = y0;
+}
+
+template<typename word_t, unsigned int... I>
+__attribute__((always_inline))
+inline void sparkle512_unrolled_steps(word_t * state,
+                                      std::integer_sequence<unsigned int, I...>)
+{
+    (sparkle512_step(state, I), ...);
+}
+
+template<unsigned int STEPS, typename word_t>
+__attribute__((always_inline))
+inline void sparkle512_permutation(word_t * state)
+{
+    sparkle512_unrolled_steps(state, std::make_integer_sequence<unsigned int, STEPS>());
+}
+
+template<typename word_t>
+__attribute__((always_inline))
+inline void sparkle512_permutation(word_t * state, const unsigned int steps)
+{
+    switch(steps) {
+    case 7:  sparkle512_permutation<7>(state);  break;
+    case 8:  sparkle512_permutation<8>(state);  break;
+    case 10: sparkle512_permutation<10>(state); break;
+    case 11: sparkle512_permutation<11>(state); break;
+    case 12: sparkle512_permutation<12>(state); break;
+    default:
+        for(unsigned int i = 0; i < steps; i ++)
+            sparkle512_step(state, i);
+    }
+}
+
+#define SQUEEZE_PARITY 0
+#define SQUEEZE_COPY   1
+
+#define SPARKLE512_DOMAIN_FORK 8
+#define SPARKLE512_DOMAIN_POOL 32
+
+#define SPARKLE512_STATE_MAGIC   0x3253504b  // the bytes "KPS2"
+#define SPARKLE512_STATE_VERSION 2
+#define SPARKLE512_MAX_STEPS     64
+
+#define RANGE_REJECTION 0
+#define RANGE_MULTIPLY  1
+#define RANGE_MULTIPLY_EXTRA_BITS 8
+
+template<typename T>
+void Sparkle512core::fill_words(T * out,
+                                const size_t count,
+                                const unsigned int n)
+{
+    size_t i = 0;
+    if ((n > 0) && (64 % n == 0))
+    {
+        const unsigned int per_word = 64 / n;
+        const uint64_t mask = (n == 64) ? ~((uint64_t)0) : (((uint64_t)1) << n) - 1;
+        const size_t full_words = count - count % per_word;
+        for (; i < full_words; i += per_word)
+        {
+            uint64_t word = get_n_bit_unsigned_integer(64);
+            for (unsigned int t=0; t<per_word; t++)
+            {
+                out[i + t] = (T)(word & mask);
+                word = (n == 64) ? 0 : word >> n;
+            }
+        }
+    }
+    for (; i<count; i++)
+        out[i] = (T)get_n_bit_unsigned_integer(n);
+}
+
+template<unsigned int LANES>
+struct Sparkle512lanes
+{
+    typedef uint32_t word_t __attribute__((vector_size(4*LANES)));
+};
+
+template<typename T>
+void Sparkle512core::shuffle(T * data, const size_t n)
+{
+    for (size_t i=0; i<n; i++)
+    {
+        const size_t j = get_unsigned_integer_in_range(i, n);
+        std::swap(data[i], data[j]);
+    }
+}
+
+template<typename T>
+void Sparkle512core::shuffle_batched(T * data, const size_t n)
+{
+    const uint64_t max_product = ((uint64_t)1) << 63;
+    size_t i = 0;
+    while (i < n)
+    {
+        // grouping as many indices as possible
+        uint64_t product = n - i;
+        size_t k = i + 1;
+        while ((k < n) && (product <= max_product / (n - k)))
+        {
+            product *= n - k;
+            k ++;
+        }
+        // drawing them all at once
+        uint64_t u = get_unsigned_integer_in_range(0, product);
+        for (; i < k; i++)
+        {
+            const size_t j = i + (u % (n - i));
+            u /= n - i;
+            std::swap(data[i], data[j]);
+        }
+    }
+}
+
+#define SPARKLE512_EXACT_DOUBLE (((uint64_t)1) << 53)
+
+template<typename T>
+void Sparkle512core::random_functions(T * out,
+                                      const size_t n_tables,
+                                      const unsigned int in_bits,
+                                      const unsigned int out_bits)
+{
+    fill_words(out, n_tables << in_bits, out_bits);
+}
+
+template<typename T>
+void Sparkle512core::random_sboxes(T * out,
+                                   const size_t n_tables,
+                                   const unsigned int n_bits)
+{
+    const size_t size = ((size_t)1) << n_bits;
+    for (size_t t=0; t<n_tables; t++)
+    {
+        T * table = out + t * size;
+        for (size_t x=0; x<size; x++)
+            table[x] = (T)x;
+        shuffle(table, size);
+    }
+}
+
+#define ZIGGURAT_NORMAL_LAYERS 128
+#define ZIGGURAT_NORMAL_R 3.442619855899
+#define ZIGGURAT_NORMAL_V 9.91256303526217e-3
+#define ZIGGURAT_EXPONENTIAL_LAYERS 256
+#define ZIGGURAT_EXPONENTIAL_R 7.69711747013104972
+#define ZIGGURAT_EXPONENTIAL_V 3.949659822581572e-3
+
+struct Sparkle512ziggurat
+{
+    double normal_x[ZIGGURAT_NORMAL_LAYERS + 1];
+    double normal_ratio[ZIGGURAT_NORMAL_LAYERS];
+    double exponential_x[ZIGGURAT_EXPONENTIAL_LAYERS + 1];
+    double exponential_ratio[ZIGGURAT_EXPONENTIAL_LAYERS];
+    Sparkle512ziggurat();
+};
+
+#define BINOMIAL_BTRS_THRESHOLD 10
+
+#define SPARKLE512_POOL_CHUNK 4096
+
+class Sparkle512pool {
+private:
+    Sparkle512core chunks_root;
+    unsigned int threads;
+    uint64_t next_chunk;
+public:
+    Sparkle512pool();
+    void setup(const Sparkle512core & parent, const unsigned int n_threads);
+    unsigned int n_threads() const;
+    void fill(uint64_t * out, const size_t count, const unsigned int n);
+    void fill_in_range(uint64_t * out,
+                       const size_t count,
+                       const uint64_t lower_bound,
+                       const uint64_t upper_bound);
+    static unsigned int max_threads();
+};
+
+#if __cplusplus >= 202002L
+#include<random>
+static_assert(std::uniform_random_bit_generator<Sparkle512core>,
+              "Sparkle512core must be a uniform random bit generator");
+#endif
+
+#ifdef SPARKLE512_HEADER_ONLY
+#define SPARKLE512_INLINE inline
+#else
+#define SPARKLE512_INLINE
+#endif
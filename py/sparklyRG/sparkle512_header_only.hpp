@@ -0,0 +1,3 @@
+#pragma once
+#define SPARKLE512_HEADER_ONLY
+#include "sparkle512.cpp"
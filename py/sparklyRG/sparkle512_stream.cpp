@@ -0,0 +1,119 @@
+#include "sparkle512.cpp"
+#include<cstdio>
+#include<cstdlib>
+#include<cstring>
+#include<csignal>
+
+#define STREAM_BUFFER_WORDS 65536
+
+
+static void usage(const char * name)
+{
+    fprintf(stderr,
+            "usage: %s [--steps S] [--rate R] [--squeeze parity|copy]"
+            " [--seed X]... [--lanes L] [--bytes N]\n",
+            name);
+    exit(1);
+}
+
+
+static void absorb_seed(Sparkle512core & core, const char * seed)
+{
+    const size_t length = strlen(seed);
+    if (length > 31)
+    {
+        core.absorb_update((const uint8_t *)seed, length);
+        core.absorb_final();
+    }
+    else
+        core.absorb((const uint8_t *)seed, length);
+}
+
+
+int main(int argc, char ** argv)
+{
+    unsigned int
+        steps = 8,
+        rate = 256,
+        squeeze = SQUEEZE_PARITY,
+        n_lanes = 1;
+    uint64_t n_bytes = 0;       // 0 means no limit
+    std::vector<const char *> seeds;
+    for (int i=1; i<argc; i++)
+    {
+        if (i + 1 == argc)
+            usage(argv[0]);
+        const char * value = argv[++i];
+        if (strcmp(argv[i-1], "--steps") == 0)
+            steps = atoi(value);
+        else if (strcmp(argv[i-1], "--rate") == 0)
+            rate = atoi(value);
+        else if (strcmp(argv[i-1], "--squeeze") == 0)
+        {
+            if (strcmp(value, "parity") == 0)
+                squeeze = SQUEEZE_PARITY;
+            else if (strcmp(value, "copy") == 0)
+                squeeze = SQUEEZE_COPY;
+            else
+                usage(argv[0]);
+        }
+        else if (strcmp(argv[i-1], "--seed") == 0)
+            seeds.push_back(value);
+        else if (strcmp(argv[i-1], "--lanes") == 0)
+            n_lanes = atoi(value);
+        else if (strcmp(argv[i-1], "--bytes") == 0)
+            n_bytes = strtoull(value, NULL, 10);
+        else
+            usage(argv[0]);
+    }
+    if ((steps == 0) || (rate == 0) || (rate % 32 != 0) || (rate > 512) || (n_lanes == 0))
+        usage(argv[0]);
+    if (seeds.empty())
+        seeds.push_back("0");
+    signal(SIGPIPE, SIG_DFL);
+
+    Sparkle512core core;
+    core.setup(steps, rate, squeeze);
+    for (const char * seed : seeds)
+        absorb_seed(core, seed);
+    std::vector<Sparkle512core> lanes(n_lanes);
+    std::vector<Sparkle512core*> pointers(n_lanes);
+    if (n_lanes > 1)
+        core.split(lanes.data(), n_lanes);
+    else
+        lanes[0] = core;
+    for (unsigned int l=0; l<n_lanes; l++)
+        pointers[l] = &lanes[l];
+
+    const size_t per_lane = STREAM_BUFFER_WORDS / n_lanes + 1;
+    std::vector<uint64_t>
+        outputs(per_lane * n_lanes),
+        interleaved(per_lane * n_lanes);
+    while (true)
+    {
+        const uint64_t * buffer = outputs.data();
+        if (n_lanes > 1)
+        {
+            Sparkle512core::fill_many(pointers.data(), n_lanes, outputs.data(), per_lane, 64);
+            for (size_t i=0; i<per_lane; i++)
+                for (unsigned int l=0; l<n_lanes; l++)
+                    interleaved[i * n_lanes + l] = outputs[l * per_lane + i];
+            buffer = interleaved.data();
+        }
+        else
+            lanes[0].fill(outputs.data(), per_lane, 64);
+        size_t length = per_lane * n_lanes * sizeof(uint64_t);
+        if ((n_bytes > 0) && (n_bytes < length))
+            length = n_bytes;
+        if (fwrite(buffer, 1, length, stdout) != length)
+            return 0;
+        if (n_bytes > 0)
+        {
+            n_bytes -= length;
+            if (n_bytes == 0)
+                break;
+        }
+    }
+    fflush(stdout);
+    return 0;
+}
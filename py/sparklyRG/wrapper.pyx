@@ -1,16 +1,363 @@
 from declaration cimport *
+from cython.view cimport array as cvarray
+import array
+import copy
+import os
+
+
+RANGE_MODES = {
+    "rejection" : 0,
+    "multiply" : 1,
+}
+
+SQUEEZE_MODES = {
+    "parity" : 0,
+    "copy" : 1,
+}
+
+cdef uint64_t[::1] _uint64_buffer(count, out):
+    cdef uint64_t[::1] result
+    if out is None:
+        result = cvarray(shape=(max(count, 1),),
+                         itemsize=sizeof(uint64_t),
+                         format="Q")
+    else:
+        result = out
+    if result.shape[0] < count:
+        raise Exception("`out` must contain at least `count` elements")
+    return result[:count]
+
+
+cdef uint64_t[:, ::1] _bit_matrix_buffer(rows, cols, out):
+    cdef uint64_t[:, ::1] result
+    row_words = (cols + 63) // 64
+    if out is None:
+        result = cvarray(shape=(max(rows, 1), max(row_words, 1)),
+                         itemsize=sizeof(uint64_t),
+                         format="Q")
+    else:
+        result = out
+    if result.shape[0] < rows or result.shape[1] != max(row_words, 1):
+        raise Exception("`out` must have `rows` lines of `(cols + 63) // 64` words")
+    return result[:rows, :row_words]
+
+
+cdef double[::1] _double_buffer(count, out):
+    cdef double[::1] result
+    if out is None:
+        result = cvarray(shape=(max(count, 1),),
+                         itemsize=sizeof(double),
+                         format="d")
+    else:
+        result = out
+    if result.shape[0] < count:
+        raise Exception("`out` must contain at least `count` elements")
+    return result[:count]
+
+
+cdef uint8_t[::1] _uint8_buffer(count, out):
+    cdef uint8_t[::1] result
+    if out is None:
+        result = cvarray(shape=(max(count, 1),),
+                         itemsize=sizeof(uint8_t),
+                         format="B")
+    else:
+        result = out
+    if result.shape[0] < count:
+        raise Exception("`out` must contain at least `count` elements")
+    return result[:count]
+
+
+cdef _random_tables(Sparkle512core * core,
+                    size_t n_tables,
+                    unsigned int in_bits,
+                    unsigned int out_bits,
+                    bint bijective):
+    cdef uint8_t[:, ::1] t8
+    cdef uint16_t[:, ::1] t16
+    cdef uint32_t[:, ::1] t32
+    cdef uint64_t[:, ::1] t64
+    cdef uint8_t * p8
+    cdef uint16_t * p16
+    cdef uint32_t * p32
+    cdef uint64_t * p64
+    if out_bits > 64:
+        raise Exception("Cannot return integers more than 64-bit long")
+    if in_bits > 32:
+        raise Exception("Cannot return tables with more than 2^32 entries")
+    for width, fmt in ((8, "B"), (16, "H"), (32, "I"), (64, "Q")):
+        if out_bits <= width:
+            break
+    result = cvarray(shape=(max(n_tables, 1), (<size_t>1) << in_bits),
+                     itemsize=width // 8,
+                     format=fmt)
+    if n_tables == 0:
+        return result[:0]
+    if width == 8:
+        t8 = result
+        p8 = &t8[0, 0]
+        with nogil:
+            if bijective:
+                core.random_sboxes[uint8_t](p8, n_tables, in_bits)
+            else:
+                core.random_functions[uint8_t](p8, n_tables, in_bits, out_bits)
+    elif width == 16:
+        t16 = result
+        p16 = &t16[0, 0]
+        with nogil:
+            if bijective:
+                core.random_sboxes[uint16_t](p16, n_tables, in_bits)
+            else:
+                core.random_functions[uint16_t](p16, n_tables, in_bits, out_bits)
+    elif width == 32:
+        t32 = result
+        p32 = &t32[0, 0]
+        with nogil:
+            if bijective:
+                core.random_sboxes[uint32_t](p32, n_tables, in_bits)
+            else:
+                core.random_functions[uint32_t](p32, n_tables, in_bits, out_bits)
+    else:
+        t64 = result
+        p64 = &t64[0, 0]
+        with nogil:
+            if bijective:
+                core.random_sboxes[uint64_t](p64, n_tables, in_bits)
+            else:
+                core.random_functions[uint64_t](p64, n_tables, in_bits, out_bits)
+    return result
+
+
+def _restore_sparkle(cls, blob, attributes):
+    result = cls.__new__(cls)
+    result.load_state(blob)
+    if attributes:
+        result.__dict__.update(attributes)
+    return result
+
+
+cdef SparkleRG _new_child(SparkleRG parent):
+    cdef SparkleRG child = type(parent).__new__(type(parent))
+    attributes = getattr(parent, "__dict__", None)
+    if attributes:
+        for name, value in attributes.items():
+            setattr(child, name, copy.copy(value))
+    return child
+
 
 cdef class SparkleRG:
-    cdef Sparkle512core core
+    cdef Sparkle512core * core
+
+    def __cinit__(self):
+        self.core = new Sparkle512core()
+
+
+    def __dealloc__(self):
+        del self.core
+
     
-    def __init__(self, steps, output_rate):
-        self.core = Sparkle512core()
-        self.core.setup(steps, output_rate)
+    def __init__(self, steps, output_rate, squeeze="parity"):
+        if squeeze not in SQUEEZE_MODES:
+            raise Exception("unknown squeeze mode: {}".format(squeeze))
+        if steps < 1 or steps > SPARKLE512_MAX_STEPS:
+            raise Exception("`steps` must be between 1 and {}".format(SPARKLE512_MAX_STEPS))
+        if output_rate <= 0 or output_rate % 32 != 0 or output_rate > 512:
+            raise Exception("`output_rate` must be a positive multiple of 32, at most 512")
+        self.core[0] = Sparkle512core()
+        self.core.setup(steps, output_rate, SQUEEZE_MODES[squeeze])
+
+
+    def absorb(self, const uint8_t[::1] x):
+        if x.shape[0] > 63:
+            raise Exception("block is too big, max length is 63 bytes")
+        cdef const uint8_t * data = NULL
+        if x.shape[0] > 0:
+            data = &x[0]
+        self.core.absorb(data, x.shape[0])
+
+
+    def absorb_update(self, const uint8_t[::1] x):
+        """Streams `x` (any object implementing the buffer protocol,
+        e.g. `bytes` or an `mmap.mmap`) into the state. Once all the
+        input has been streamed, `absorb_final` must be called.
+
+        """
+        cdef const uint8_t * data
+        cdef size_t length = x.shape[0]
+        if length > 0:
+            data = &x[0]
+            with nogil:
+                self.core.absorb_update(data, length)
+
+
+    def absorb_file(self, path):
+        """Streams the content of the file at `path` into the state,
+        without reading it fully into memory. As for
+        `absorb_update`, `absorb_final` must be called once all the
+        input has been streamed.
+
+        """
+        cdef bytes encoded_path = os.fsencode(path)
+        cdef const char * c_path = encoded_path
+        with nogil:
+            self.core.absorb_file(c_path)
+
+
+    def absorb_final(self):
+        self.core.absorb_final()
+
+
+    def start_counter_mode(self):
+        """Switches to the counter mode, in which block `i` of the
+        output is derived directly from the current state and `i`,
+        so that `seek` can jump anywhere in the stream. The stream
+        starts at block 0. Absorbing a seed leaves the counter mode.
+
+        """
+        self.core.start_counter_mode()
+
+
+    def seek(self, uint64_t block_index):
+        """In counter mode, makes the next outputs start at the
+        beginning of block `block_index`.
+
+        """
+        self.core.seek(block_index)
+
+
+    def fill_blocks(self, uint64_t first_block, size_t n_blocks, out=None):
+        """In counter mode, returns a buffer of `n_blocks` lines, each
+        containing the `output_rate/32` 32-bit words of a block,
+        starting with block `first_block`. They are generated in
+        parallel, and the instance is not modified.
+
+        """
+        cdef uint32_t[:, ::1] result
+        cdef uint32_t * data
+        row_words = self.core.output_rate() // 32
+        if out is None:
+            result = cvarray(shape=(max(n_blocks, 1), max(row_words, 1)),
+                             itemsize=sizeof(uint32_t),
+                             format="I")
+        else:
+            result = out
+        if result.shape[0] < n_blocks or result.shape[1] != max(row_words, 1):
+            raise Exception("`out` must have `n_blocks` lines of `output_rate/32` words")
+        if n_blocks > 0 and row_words > 0:
+            data = &result[0, 0]
+            with nogil:
+                self.core.fill_blocks(data, first_block, n_blocks)
+        return result[:n_blocks, :row_words]
+
 
+    def save_state(self):
+        """Returns a `bytes` object from which `load_state` can
+        restore this instance exactly as it is now (including the
+        position in its output stream).
 
-    def absorb(self, x):
-        to_absorb = x + b"1" + b"0"*(63 - len(x))
-        self.core.absorb(to_absorb)
+        """
+        cdef vector[uint8_t] blob = self.core.save_state()
+        return (<const char *>blob.data())[:blob.size()]
+
+
+    def load_state(self, const uint8_t[::1] blob):
+        """Restores the state saved by `save_state`."""
+        cdef const uint8_t * data = NULL
+        if blob.shape[0] > 0:
+            data = &blob[0]
+        self.core.load_state(data, blob.shape[0])
+
+
+    def counters(self):
+        """Returns a dictionary containing the performance counters of
+        this instance (`permutations`, `bits`, `rejections` and
+        `cycles`), or `None` if the module was compiled without them.
+
+        """
+        cdef Sparkle512counters c = self.core.get_counters()
+        if not Sparkle512core.counters_enabled():
+            return None
+        return {
+            "permutations" : c.permutations,
+            "bits" : c.bits,
+            "rejections" : c.rejections,
+            "cycles" : c.cycles,
+        }
+
+
+    def reset_counters(self):
+        self.core.reset_counters()
+
+
+    def __reduce__(self):
+        return (_restore_sparkle,
+                (type(self), self.save_state(), getattr(self, "__dict__", None)))
+
+
+    def fork(self, index):
+        """Returns a new instance of the same class, derived
+        deterministically from the state of this one and from the
+        integer `index`, which produces an independent stream. This
+        instance is not modified.
+
+        """
+        cdef SparkleRG child = _new_child(self)
+        self.core.fork(index, child.core)
+        child._record_fork(index)
+        return child
+
+
+    def split(self, size_t k):
+        """Returns the list `[self.fork(i) for i in range(0, k)]`, but
+        computes it much faster.
+
+        """
+        cdef vector[Sparkle512core] children
+        children.resize(k)
+        if k > 0:
+            with nogil:
+                self.core.split(children.data(), k)
+        result = []
+        cdef SparkleRG child
+        for i in range(0, k):
+            child = _new_child(self)
+            child.core[0] = children[i]
+            child._record_fork(i)
+            result.append(child)
+        return result
+
+
+    def _record_fork(self, index):
+        """Called on the children returned by `fork` and `split`, with
+        their index, after their attributes have been copied from
+        their parent. Subclasses describing how they were seeded
+        override it.
+
+        """
+        pass
+
+
+    def absorb_ids(self, ids):
+        """Returns a `SparkleRGArray` whose element `j` is a copy of
+        this instance into which `str(ids[j]).encode()` has been
+        absorbed, `ids` being a list or a buffer of non-negative
+        64-bit integers. This instance is not modified.
+
+        """
+        cdef const uint64_t[::1] id_view
+        if isinstance(ids, (list, tuple, range)):
+            id_view = array.array("Q", ids)
+        else:
+            id_view = ids
+        cdef size_t k = id_view.shape[0]
+        cdef SparkleRGArray result = SparkleRGArray.__new__(SparkleRGArray)
+        result.cores.resize(k)
+        cdef const uint64_t * data
+        if k > 0:
+            data = &id_view[0]
+            with nogil:
+                self.core.absorb_ids(result.cores.data(), data, k)
+        return result
 
         
     def get_n_bit_unsigned_integer(self, n):
@@ -19,7 +366,407 @@ cdef class SparkleRG:
         return self.core.get_n_bit_unsigned_integer(n)
 
     
+    def set_range_mode(self, mode):
+        """Sets the algorithm used to generate outputs in a given
+        range: either "rejection" (the default) or "multiply"
+        (Lemire's multiply-shift, which needs fewer bits for ranges
+        just above a power of two).
+
+        """
+        if mode not in RANGE_MODES:
+            raise Exception("unknown range mode: {}".format(mode))
+        self.core.set_range_mode(RANGE_MODES[mode])
+
+
     def __call__(self, lower, upper):
         if upper <= lower:
             raise Exception("`upper` must be strictly higher than `lower`")
         return self.core.get_unsigned_integer_in_range(lower, upper)
+
+
+    def fill(self, size_t count, unsigned int n, out=None):
+        """Returns a buffer containing `count` successive outputs of
+        `get_n_bit_unsigned_integer(n)`, written in `out` if it is
+        specified.
+
+        """
+        if n > 64:
+            raise Exception("Cannot return integers more than 64-bit long")
+        cdef uint64_t[::1] result = _uint64_buffer(count, out)
+        cdef uint64_t * data
+        if count > 0:
+            data = &result[0]
+            with nogil:
+                self.core.fill(data, count, n)
+        return result
+
+
+    def fill_in_range(self, size_t count, uint64_t lower, uint64_t upper, out=None):
+        """Returns a buffer containing `count` successive outputs of
+        `self(lower, upper)`, written in `out` if it is specified.
+
+        """
+        if upper <= lower:
+            raise Exception("`upper` must be strictly higher than `lower`")
+        cdef uint64_t[::1] result = _uint64_buffer(count, out)
+        cdef uint64_t * data
+        if count > 0:
+            data = &result[0]
+            with nogil:
+                self.core.fill_in_range(data, count, lower, upper)
+        return result
+
+
+    def random_permutation(self, size_t v_size, bint batched=False, out=None):
+        """Returns a buffer containing the integers {0,...,v_size-1}
+        after undergoing a permutation picked uniformly at random
+        (using a Fisher-Yates shuffle), written in `out` if it is
+        specified.
+
+        If `batched` is set, several indices are drawn at once, which
+        is faster but yields a different permutation.
+
+        """
+        cdef uint64_t[::1] result = _uint64_buffer(v_size, out)
+        cdef uint64_t * data
+        if v_size > 0:
+            data = &result[0]
+            with nogil:
+                self.core.random_permutation(data, v_size, batched)
+        return result
+
+
+    def random_subset(self, uint64_t n, size_t k, bint sorted=False, out=None):
+        """Returns a buffer containing `k` distinct integers picked
+        uniformly in {0,...,n-1}, written in `out` if it is specified.
+
+        If `sorted` is set, they are in increasing order (when `n` is
+        above 2^53, this is obtained by sorting, so it needs more time
+        and memory); otherwise their order is not uniformly random.
+
+        """
+        if k > n:
+            raise Exception("cannot pick more than `n` distinct elements")
+        cdef uint64_t[::1] result = _uint64_buffer(k, out)
+        cdef uint64_t * data
+        if k > 0:
+            data = &result[0]
+            with nogil:
+                if sorted:
+                    self.core.random_sorted_subset(data, n, k)
+                else:
+                    self.core.random_subset(data, n, k)
+        return result
+
+
+    def shuffle(self, data, bint batched=False):
+        """Shuffles `data` in place using a Fisher-Yates shuffle.
+
+        `data` is either a list, or a buffer of 64-bit unsigned
+        integers. In both cases, its final content is `[data[j] for j
+        in p]`, where `p` is the output `random_permutation(len(data),
+        batched)` would have returned.
+
+        """
+        cdef uint64_t[::1] view
+        cdef uint64_t * entries
+        cdef size_t length
+        if isinstance(data, list):
+            permutation = self.random_permutation(len(data), batched)
+            data[:] = [data[j] for j in permutation]
+        else:
+            view = data
+            length = view.shape[0]
+            if length == 0:
+                return
+            entries = &view[0]
+            with nogil:
+                if batched:
+                    self.core.shuffle_batched[uint64_t](entries, length)
+                else:
+                    self.core.shuffle[uint64_t](entries, length)
+
+
+    def random_function(self, in_bits, out_bits, count=None):
+        """Returns the lookup table of a random function mapping
+        `in_bits` bits to `out_bits` bits, as a buffer of the
+        smallest unsigned integer type that fits.
+
+        If `count` is specified, returns instead a buffer of `count`
+        such tables (one per line).
+
+        """
+        result = _random_tables(self.core,
+                                1 if count is None else count,
+                                in_bits,
+                                out_bits,
+                                False)
+        return result[0] if count is None else result
+
+
+    def random_sbox(self, n_bits, count=None):
+        """Returns the lookup table of a random permutation of
+        {0,...,2^n_bits-1}, as a buffer of the smallest unsigned
+        integer type that fits.
+
+        If `count` is specified, returns instead a buffer of `count`
+        such tables (one per line).
+
+        """
+        result = _random_tables(self.core,
+                                1 if count is None else count,
+                                n_bits,
+                                n_bits,
+                                True)
+        return result[0] if count is None else result
+
+
+    def random_bit_matrix(self, size_t rows, size_t cols, out=None):
+        """Returns a random `rows x cols` matrix over GF(2), as a
+        buffer of `rows` lines of `(cols + 63) // 64` words, the entry
+        in column `c` being the bit `c % 64` of the word `c // 64`.
+
+        """
+        cdef uint64_t[:, ::1] result = _bit_matrix_buffer(rows, cols, out)
+        cdef uint64_t * data
+        if rows > 0 and cols > 0:
+            data = &result[0, 0]
+            with nogil:
+                self.core.random_bit_matrix(data, rows, cols)
+        return result
+
+
+    def random_bit_vector(self, size_t n, out=None):
+        """Returns a buffer of `(n + 63) // 64` words containing `n`
+        random bits (packed like a row of `random_bit_matrix`).
+
+        """
+        cdef uint64_t[::1] result = _uint64_buffer((n + 63) // 64, out)
+        cdef uint64_t * data
+        if n > 0:
+            data = &result[0]
+            with nogil:
+                self.core.random_bit_matrix(data, 1, n)
+        return result
+
+
+    def random_invertible_bit_matrix(self, size_t n, out=None):
+        """Returns a uniformly distributed invertible `n x n` matrix
+        over GF(2), packed like for `random_bit_matrix`.
+
+        """
+        cdef uint64_t[:, ::1] result = _bit_matrix_buffer(n, n, out)
+        cdef uint64_t * data
+        if n > 0:
+            data = &result[0, 0]
+            with nogil:
+                self.core.random_invertible_bit_matrix(data, n)
+        return result
+
+
+    def random(self):
+        """Returns a uniform float in [0, 1), with 53 bits of
+        precision.
+
+        """
+        return self.core.get_uniform_double()
+
+
+    def normal(self, double mean=0.0, double stddev=1.0):
+        return mean + stddev * self.core.get_normal()
+
+
+    def exponential(self, double rate=1.0):
+        if rate <= 0:
+            raise Exception("`rate` must be positive")
+        return self.core.get_exponential() / rate
+
+
+    def bernoulli(self, double p):
+        if not (0 <= p <= 1):
+            raise Exception("`p` must be in [0, 1]")
+        return self.core.get_bernoulli(p)
+
+
+    def binomial(self, uint64_t trials, double p):
+        if not (0 <= p <= 1):
+            raise Exception("`p` must be in [0, 1]")
+        return self.core.get_binomial(trials, p)
+
+
+    def fill_uniform(self, size_t count, out=None):
+        """Returns a buffer of `count` doubles obtained like with
+        `random()`, written in `out` if it is specified.
+
+        """
+        cdef double[::1] result = _double_buffer(count, out)
+        cdef double * data
+        if count > 0:
+            data = &result[0]
+            with nogil:
+                self.core.fill_uniform(data, count)
+        return result
+
+
+    def fill_normal(self, size_t count, double mean=0.0, double stddev=1.0, out=None):
+        cdef double[::1] result = _double_buffer(count, out)
+        cdef double * data
+        if count > 0:
+            data = &result[0]
+            with nogil:
+                self.core.fill_normal(data, count, mean, stddev)
+        return result
+
+
+    def fill_exponential(self, size_t count, double rate=1.0, out=None):
+        if rate <= 0:
+            raise Exception("`rate` must be positive")
+        cdef double[::1] result = _double_buffer(count, out)
+        cdef double * data
+        if count > 0:
+            data = &result[0]
+            with nogil:
+                self.core.fill_exponential(data, count, rate)
+        return result
+
+
+    def fill_bernoulli(self, size_t count, double p, out=None):
+        """Returns a buffer of `count` bytes, each being equal to 1
+        with probability `p` and to 0 otherwise.
+
+        """
+        if not (0 <= p <= 1):
+            raise Exception("`p` must be in [0, 1]")
+        cdef uint8_t[::1] result = _uint8_buffer(count, out)
+        cdef uint8_t * data
+        if count > 0:
+            data = &result[0]
+            with nogil:
+                self.core.fill_bernoulli(data, count, p)
+        return result
+
+
+    def fill_binomial(self, size_t count, uint64_t trials, double p, out=None):
+        if not (0 <= p <= 1):
+            raise Exception("`p` must be in [0, 1]")
+        cdef uint64_t[::1] result = _uint64_buffer(count, out)
+        cdef uint64_t * data
+        if count > 0:
+            data = &result[0]
+            with nogil:
+                self.core.fill_binomial(data, count, trials, p)
+        return result
+
+
+
+def fill_many(generators, size_t count, unsigned int n):
+    """Returns a buffer `b` of `len(generators)` lines such that
+    `b[k]` contains the same outputs as `generators[k].fill(count,
+    n)`; the generators being processed in parallel.
+
+    """
+    if n > 64:
+        raise Exception("Cannot return integers more than 64-bit long")
+    cdef vector[Sparkle512core*] cores
+    cdef SparkleRG rg
+    for rg in generators:
+        cores.push_back(rg.core)
+    cdef uint64_t[:, ::1] result = cvarray(
+        shape=(max(cores.size(), 1), max(count, 1)),
+        itemsize=sizeof(uint64_t),
+        format="Q")
+    cdef uint64_t * data = &result[0, 0]
+    if cores.size() > 0 and count > 0:
+        with nogil:
+            Sparkle512core.fill_many(cores.data(), cores.size(), data, count, n)
+    return result[:cores.size(), :count]
+
+
+def lanes():
+    """Returns the number of generators that `fill_many`
+    processes in parallel on this CPU.
+
+    """
+    return Sparkle512core.lanes()
+
+
+
+cdef class SparkleRGArray:
+    cdef vector[Sparkle512core] cores
+
+    def __len__(self):
+        return self.cores.size()
+
+
+    def __getitem__(self, index):
+        cdef SparkleRG result = SparkleRG.__new__(SparkleRG)
+        self.copy_into(index, result)
+        return result
+
+
+    def copy_into(self, index, SparkleRG target):
+        """Overwrites the state of `target` with that of the instance
+        of index `index` in this array.
+
+        """
+        if index < 0:
+            index += self.cores.size()
+        if index < 0 or index >= self.cores.size():
+            raise IndexError("SparkleRGArray index out of range")
+        target.core[0] = self.cores[index]
+
+
+
+cdef class SparklePool:
+    cdef Sparkle512pool * pool
+
+    def __cinit__(self):
+        self.pool = new Sparkle512pool()
+
+
+    def __dealloc__(self):
+        del self.pool
+
+
+    def __init__(self, SparkleRG parent, n_threads=None):
+        if n_threads is None:
+            n_threads = Sparkle512pool.max_threads()
+        self.pool.setup(parent.core[0], n_threads)
+
+
+    def n_threads(self):
+        return self.pool.n_threads()
+
+
+    def fill(self, size_t count, unsigned int n, out=None):
+        """Same as `SparkleRG.fill`, except that the buffer is filled
+        in parallel. The result does not depend on the number of
+        threads.
+
+        """
+        if n > 64:
+            raise Exception("Cannot return integers more than 64-bit long")
+        cdef uint64_t[::1] result = _uint64_buffer(count, out)
+        cdef uint64_t * data
+        if count > 0:
+            data = &result[0]
+            with nogil:
+                self.pool.fill(data, count, n)
+        return result
+
+
+    def fill_in_range(self, size_t count, uint64_t lower, uint64_t upper, out=None):
+        """Same as `SparkleRG.fill_in_range`, except that the buffer is
+        filled in parallel. The result does not depend on the number
+        of threads.
+
+        """
+        if upper <= lower:
+            raise Exception("`upper` must be strictly higher than `lower`")
+        cdef uint64_t[::1] result = _uint64_buffer(count, out)
+        cdef uint64_t * data
+        if count > 0:
+            data = &result[0]
+            with nogil:
+                self.pool.fill_in_range(data, count, lower, upper)
+        return result
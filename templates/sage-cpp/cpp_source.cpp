@@ -1,8 +1,124 @@
 #include <iostream>
 #include <string>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// The PRG of levain (see py/sparklyRG.org); setup.py adds its folder
+// to the include path.
+#include "sparkle512_header_only.hpp"
 
 
 void cpp_print(std::string to_print)
 {
     std::cout << to_print << std::endl ;
 }
+
+
+// !SECTION! Threads
+
+// `n_threads` equal to 0 means as many as OpenMP would use.
+unsigned int cpp_n_threads(unsigned int n_threads)
+{
+#ifdef _OPENMP
+    if (n_threads == 0)
+        n_threads = omp_get_max_threads();
+    return n_threads;
+#else
+    return 1;
+#endif
+}
+
+
+// !SECTION! Working on a buffer
+
+// The arrays are those of the numpy arrays given to mylib.pyx: they
+// are never copied. Since the GIL is released by the caller, the
+// threads of OpenMP can run in parallel. As all iterations cost the
+// same, a static schedule is best.
+void cpp_hamming_weights(const uint64_t * in,
+                         uint8_t * out,
+                         const size_t length,
+                         const unsigned int n_threads)
+{
+    #pragma omp parallel for schedule(static) num_threads(cpp_n_threads(n_threads))
+    for (size_t i=0; i<length; i++)
+        out[i] = __builtin_popcountll(in[i]);
+}
+
+
+// !SECTION! A PRG for each thread
+
+// The cores are obtained by splitting an instance seeded like
+// `EschRG(seed)`, so that they are those of `EschRG(seed).split(k)`:
+// as in `EschRG._absorb_block`, seeds longer than 31 bytes are
+// streamed.
+//
+// The work is cut into one chunk per core, chunk i being handled by
+// core i whatever the thread that runs it: the outputs only depend
+// on the seed and on the number of cores, not on the scheduling.
+class ThreadRNGs
+{
+public:
+    std::vector<Sparkle512core> cores;
+
+    ThreadRNGs(const uint8_t * seed, const size_t length, const unsigned int n_cores) :
+        cores(n_cores)
+    {
+        Sparkle512core parent;
+        parent.setup(8, 256);
+        if (length > 31)
+        {
+            parent.absorb_update(seed, length);
+            parent.absorb_final();
+        }
+        else
+            parent.absorb(seed, length);
+        parent.split(cores.data(), cores.size());
+    }
+
+    size_t size() const
+    {
+        return cores.size();
+    }
+
+    // the beginning of the chunk of core i when `total` items are
+    // cut into `size()` chunks
+    size_t chunk_start(const size_t i, const size_t total) const
+    {
+        return (total / cores.size()) * i + std::min(i, total % cores.size());
+    }
+
+    void fill(uint64_t * out, const size_t length, const unsigned int n_bits)
+    {
+        #pragma omp parallel for schedule(static, 1) num_threads(cores.size())
+        for (size_t i=0; i<cores.size(); i++)
+        {
+            const size_t start = chunk_start(i, length);
+            cores[i].fill(out + start, chunk_start(i+1, length) - start, n_bits);
+        }
+    }
+
+    // A typical Monte Carlo simulation: estimates pi using
+    // `n_samples` random points of the unit square.
+    double estimate_pi(const uint64_t n_samples)
+    {
+        uint64_t inside = 0;
+        #pragma omp parallel for schedule(static, 1) num_threads(cores.size()) reduction(+:inside)
+        for (size_t i=0; i<cores.size(); i++)
+        {
+            const uint64_t count = chunk_start(i+1, n_samples) - chunk_start(i, n_samples);
+            for (uint64_t j=0; j<count; j++)
+            {
+                const double
+                    x = cores[i].get_uniform_double(),
+                    y = cores[i].get_uniform_double();
+                inside += (x*x + y*y < 1);
+            }
+        }
+        return 4.0 * inside / n_samples;
+    }
+};
@@ -1,13 +1,25 @@
 #!/usr/bin/sage
 #-*- Python -*-
-# Time-stamp: <2024-08-01 16:31:14 lperrin>
+# Time-stamp: <2026-10-14 09:18:23 lperrin>
 
 
 from libcpp cimport bool
 from libcpp.vector cimport vector
 from libcpp.map cimport map
 from libcpp.string cimport string
-from libc.stdint cimport int64_t, uint64_t
+from libc.stdint cimport int64_t, uint64_t, uint8_t
 
 cdef extern from "cpp_source.cpp":
     cdef void cpp_print(const string to_print)
+    # the functions that are called without the GIL must be declared
+    # `nogil`
+    cdef unsigned int cpp_n_threads(unsigned int n_threads) nogil
+    cdef void cpp_hamming_weights(const uint64_t * values,
+                                  uint8_t * out,
+                                  size_t length,
+                                  unsigned int n_threads) nogil
+    cdef cppclass ThreadRNGs:
+        ThreadRNGs(const uint8_t * seed, size_t length, unsigned int n_cores)
+        size_t size()
+        void fill(uint64_t * out, size_t length, unsigned int n_bits) nogil
+        double estimate_pi(uint64_t n_samples) nogil
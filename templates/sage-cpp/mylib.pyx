@@ -1,9 +1,80 @@
 #!/usr/bin/sage
 #-*- Python -*-
-# Time-stamp: <2024-08-01 16:32:37 lperrin>
+# Time-stamp: <2026-10-14 09:18:23 lperrin>
 
 import os
+import numpy
 from cpython_declaration cimport *
 
 def our_print(to_print):
     cpp_print(to_print)
+
+
+# !SECTION! Passing buffers
+
+# A typed memoryview (`const uint64_t[::1]`) accepts any contiguous
+# buffer (numpy array, bytes, array.array...) without copying it, and
+# gives a pointer to its content. The output is allocated by numpy,
+# and written in place by the C++ function.
+
+def hamming_weights(const uint64_t[::1] values, unsigned int n_threads=0):
+    """Returns a numpy array containing the Hamming weight of each
+    entry of `values` (e.g. a numpy array of dtype uint64), computed
+    using `n_threads` threads (0 meaning as many as possible).
+
+    """
+    cdef size_t length = values.shape[0]
+    result = numpy.empty(length, dtype=numpy.uint8)
+    cdef uint8_t[::1] out = result
+    if length > 0:
+        # the GIL must be released for the OpenMP threads to run in
+        # parallel
+        with nogil:
+            cpp_hamming_weights(&values[0], &out[0], length, n_threads)
+    return result
+
+
+# !SECTION! Randomness
+
+cdef class ThreadedRNG:
+    """A set of PRGs, one per thread, derived from the bytes `seed` like
+    `EschRG(seed).split(n_threads)` would (`n_threads` equal to 0
+    meaning as many as possible). The outputs only depend on `seed`
+    and on the number of threads.
+
+    """
+    # C++ classes without a default constructor must be held through
+    # a pointer (which also ensures that the cores are properly
+    # aligned)
+    cdef ThreadRNGs * rngs
+
+    def __cinit__(self, const uint8_t[::1] seed, unsigned int n_threads=0):
+        self.rngs = new ThreadRNGs(&seed[0] if seed.shape[0] > 0 else NULL,
+                                   seed.shape[0],
+                                   cpp_n_threads(n_threads))
+
+    def __dealloc__(self):
+        del self.rngs
+
+    def n_threads(self):
+        return self.rngs.size()
+
+    def fill(self, size_t count, unsigned int n_bits=64):
+        """Returns a numpy array of `count` random `n_bits`-bit integers."""
+        if n_bits > 64:
+            raise Exception("Cannot return integers more than 64-bit long")
+        result = numpy.empty(count, dtype=numpy.uint64)
+        cdef uint64_t[::1] out = result
+        if count > 0:
+            with nogil:
+                self.rngs.fill(&out[0], count, n_bits)
+        return result
+
+    def estimate_pi(self, uint64_t n_samples):
+        """Estimates pi using `n_samples` random points of the unit square."""
+        if n_samples == 0:
+            raise Exception("`n_samples` must be positive")
+        cdef double result
+        with nogil:
+            result = self.rngs.estimate_pi(n_samples)
+        return result
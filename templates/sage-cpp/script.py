@@ -6,6 +6,8 @@ from sage.all import *
 
 from sys import argv
 import os
+import time
+import numpy
 
 from mylib import *
 
@@ -28,6 +30,16 @@ from mylib import *
 - `setup.py` describes how the C++ code should be compiled.
 
 
+The C++ functions show how to pass numpy arrays without copying them
+(`hamming_weights`), how to release the GIL and run OpenMP loops, and
+how to give a Sparkle512-based PRG to each thread (`ThreadedRNG`). The
+PRG comes from `py/sparklyRG` in levain: if this folder is copied
+elsewhere, set the `SPARKLYRG_DIR` environment variable to the folder
+containing `sparkle512_header_only.hpp` before compiling.
+
+Run `sage script.py bench` to compare them with pure SAGE.
+
+
 To compile the C++ part, use `sage setup.py build_ext --inplace`.
 
 /!\ Do NOT call the c++ source file `mylib.cpp`: during compilation,
@@ -36,10 +48,72 @@ To compile the C++ part, use `sage setup.py build_ext --inplace`.
 
 """
 
+# !SECTION! Timing harness
+
+def best_time(f, *args, repeat=3):
+    """Returns the output of `f(*args)` and the shortest time (in
+    seconds) it took over `repeat` runs.
+
+    """
+    best = None
+    for r in range(0, repeat):
+        start = time.perf_counter()
+        result = f(*args)
+        elapsed = time.perf_counter() - start
+        if best is None or elapsed < best:
+            best = elapsed
+    return result, best
+
+
+def compare(name, cpp_function, sage_function, *args):
+    cpp_result, cpp_time = best_time(cpp_function, *args)
+    sage_result, sage_time = best_time(sage_function, *args, repeat=1)
+    print("{:20s} C++: {:.4f}s  SAGE: {:.4f}s  speed-up: {:.1f}".format(
+        name,
+        cpp_time,
+        sage_time,
+        sage_time / cpp_time
+    ))
+    return cpp_result, sage_result
+
+
+# !SUBSECTION! The pure SAGE versions
+
+def sage_hamming_weights(values):
+    return [Integer(x).popcount() for x in values]
+
+
+def sage_estimate_pi(n_samples):
+    inside = 0
+    for i in range(0, n_samples):
+        x, y = random(), random()
+        if x**2 + y**2 < 1:
+            inside += 1
+    return 4.0 * inside / n_samples
+
+
+def bench():
+    rngs = ThreadedRNG(b"bench")
+    print("using {} threads".format(rngs.n_threads()))
+    values = rngs.fill(10**6)
+    cpp_weights, sage_weights = compare("hamming weights",
+                                        hamming_weights,
+                                        sage_hamming_weights,
+                                        values)
+    assert list(cpp_weights) == sage_weights
+    cpp_pi, sage_pi = compare("estimating pi",
+                              rngs.estimate_pi,
+                              sage_estimate_pi,
+                              10**6)
+    print("pi ~ {} (C++), {} (SAGE)".format(cpp_pi, sage_pi))
+
+
 # !SECTION! Main program 
 
 if __name__ == "__main__":
     if len(argv) < 2:
         print("needs at least one argument")
+    elif argv[1] == "bench":
+        bench()
     else:
         our_print(argv[1].encode("ascii"))
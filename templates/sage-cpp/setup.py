@@ -21,12 +21,18 @@ else:
     extra_compile_args += ['-fopenmp']
     extra_link_args += ['-fopenmp']
 
+# the folder containing sparkle512_header_only.hpp; the default works
+# as long as this folder is used in place
+SPARKLYRG_DIR = os.environ.get(
+    "SPARKLYRG_DIR",
+    os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "..", "py", "sparklyRG")
+)
 
 
 module_mylib = Extension("mylib",
                          sources=["mylib.pyx"],
                          libraries=[],
-                         include_dirs=['.'], 
+                         include_dirs=['.', SPARKLYRG_DIR], 
                          language='c++',
                          extra_link_args=extra_link_args,
                          extra_compile_args=extra_compile_args)